@@ -0,0 +1,91 @@
+#ifndef ANALYSIS_HPP
+#define ANALYSIS_HPP
+
+#include <vector>
+
+#include "chip.hpp"
+
+// static control flow analysis of a ROM image, done once before it runs
+// code is whatever can be reached from 0x200 by following jumps, calls,
+// returns and both ways out of every skip, without executing anything
+// BNNN goes somewhere that depends on a register, so code only reached
+// through one is not found
+// I is followed through the code wherever ANNN leaves it known, which tells
+// the bytes sprites and FX65 read apart from the instructions around them
+class Analysis {
+  public:
+    // what a byte of the image was found to be, more than one can apply
+    // an instruction starts here
+    static const Byte instruction = 1;
+    // part of a reachable instruction
+    static const Byte code = 2;
+    // read by DXYN or FX65
+    static const Byte data = 4;
+    // written by FX33 or FX55
+    static const Byte written = 8;
+
+    // a run of instructions that is only ever entered at its first one
+    struct Block {
+        unsigned short start;
+        // the address after its last instruction
+        unsigned short end;
+        // where execution goes next, for a call the subroutine and then the
+        // instruction it returns to, none after 00EE, BNNN, 00FD or an
+        // illegal opcode
+        std::vector<unsigned short> successors;
+    };
+
+    // an empty image, nothing reachable
+    Analysis() : m_selfModifying(false) {}
+    Analysis(const Byte* image, size_t size);
+
+    // in address order
+    const std::vector<Block>& blocks() const { return m_blocks; }
+    // every reachable instruction, in address order
+    const std::vector<unsigned short>& instructions() const {
+        return m_instructions;
+    }
+    // reachable opcodes that would stop the machine
+    const std::vector<unsigned short>& illegal() const { return m_illegal; }
+    // instructions that jump, call or run on past the end of the image
+    const std::vector<unsigned short>& escapes() const { return m_escapes; }
+    // BNNN instructions, the code they reach may be missing
+    const std::vector<unsigned short>& indirect() const {
+        return m_indirect;
+    }
+    // whether FX33 or FX55 can write over reachable code
+    bool selfModifying() const { return m_selfModifying; }
+
+    // 0 outside the image
+    Byte use(unsigned short address) const {
+        return inside(address) ? m_use[address - 0x200] : 0;
+    }
+    Opcode opcode(unsigned short address) const;
+    bool inside(unsigned short address) const {
+        return address >= 0x200 &&
+               (size_t)(address - 0x200) < m_image.size();
+    }
+    size_t size() const { return m_image.size(); }
+
+  private:
+    // where I is known to point when a block starts, see Analysis()
+    void followIndex();
+    // whether nothing reachable from a subroutine changes I
+    bool keepsIndex(const std::vector<int>& blockAt,
+                    unsigned short subroutine) const;
+    // marks what the instructions of a block read and write through I
+    void markData(const Block& block, unsigned short index);
+
+    std::vector<Byte> m_image;
+    std::vector<Byte> m_use;
+    std::vector<Block> m_blocks;
+    // I on entry to each block
+    std::vector<unsigned short> m_entryIndex;
+    std::vector<unsigned short> m_instructions;
+    std::vector<unsigned short> m_illegal;
+    std::vector<unsigned short> m_escapes;
+    std::vector<unsigned short> m_indirect;
+    bool m_selfModifying;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef BEEPER_HPP
+#define BEEPER_HPP
+
+#include <vector>
+
+#include <SFML/Audio.hpp>
+
+// the CHIP-8 buzzer, a square wave synthesized on SFML's audio thread
+// the host starts and stops it when the sound timer starts and stops
+// running, nothing is done per instruction or per frame in between
+// buffers are a few milliseconds long so the tone starts and stops close to
+// the frame that asked for it
+class Beeper : public sf::SoundStream {
+  public:
+    Beeper(float frequency = 440.0f, sf::Int16 amplitude = 3000);
+    // the audio thread calls back into this class, so it has to be stopped
+    // before anything here is destroyed
+    ~Beeper();
+
+    // starts or stops the tone, only a change from the last call does
+    // anything
+    void setActive(bool active);
+
+  private:
+    bool onGetData(Chunk& data) override;
+    void onSeek(sf::Time timeOffset) override;
+
+    bool m_active;
+    // samples per half period of the wave, and how far into the current
+    // half period the next sample is
+    float m_halfPeriod;
+    float m_phase;
+    sf::Int16 m_amplitude;
+    // refilled on the audio thread each time SFML asks for more
+    std::vector<sf::Int16> m_samples;
+};
+
+#endif
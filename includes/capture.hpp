@@ -0,0 +1,130 @@
+#ifndef CAPTURE_HPP
+#define CAPTURE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame.hpp"
+
+#define CAPTURE_LOAD_ERR -4
+
+// capture files start with this, followed by one record per recorded frame
+// up to the end of the file
+#define CAPTURE_VERSION 1
+struct CaptureHeader {
+    char magic[4];
+    uint32_t version;
+    // frames per second the records are numbered in
+    uint32_t frameRate;
+};
+
+// in front of every frame's packed bytes
+struct CaptureRecord {
+    // frames since recording started, numbers that are missing are frames
+    // where the display stayed as it was, or that were dropped
+    uint32_t frame;
+    // bytes of packed data that follow
+    uint16_t length;
+    uint8_t hires;
+    // set when the data is the frame itself rather than its difference
+    // from the frame before
+    uint8_t key;
+};
+
+static_assert(sizeof(CaptureRecord) == 8, "capture records are 8 bytes");
+
+// records the display once per emulated frame into a file
+// the emulation thread only copies the frame into a ring buffer, a writer
+// thread encodes it and does all the disk work, so recording costs the
+// emulation a 1KB copy a frame
+// frames are stored at their native resolution, losslessly, as the
+// difference from the frame before, run length encoded, which for most
+// frames is a few bytes, with a whole frame every few seconds
+// if the writer falls behind, frames are dropped rather than slowing the
+// machine down
+class Capture {
+  public:
+    static const uint32_t frameRate = 60;
+    // frames between two key frames
+    static const uint32_t keyInterval = 5 * frameRate;
+    // a frame as it is packed, 128 words of 8 bytes
+    static const size_t frameBytes = sizeof(Frame::words);
+    // the most a frame can take once packed
+    static const size_t maxPacked = frameBytes + frameBytes / 128 + 1;
+
+    // capacity is in frames and is rounded up to a power of two
+    explicit Capture(size_t capacity = 64);
+    ~Capture();
+
+    Capture(const Capture&) = delete;
+    Capture& operator=(const Capture&) = delete;
+
+    // truncates the file, writes the header and starts the writer
+    bool start(const std::string& path);
+    // writes out whatever is still in the ring and closes the file
+    void stop();
+    bool active() const { return m_file != nullptr; }
+    uint64_t dropped() const { return m_dropped.load(); }
+
+    // called once per emulated frame, only ever from one thread
+    void record(const uint64_t* words, bool hires) {
+        uint32_t frame = m_frame++;
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) == m_ring.size()) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        Slot& slot = m_ring[head & (m_ring.size() - 1)];
+        slot.number = frame;
+        std::memcpy(slot.frame.words, words, frameBytes);
+        slot.frame.hires = hires;
+        m_head.store(head + 1, std::memory_order_release);
+    }
+
+    // the display stayed as it was for this many frames, while the machine
+    // was not running them
+    void skip(uint32_t frames) { m_frame += frames; }
+
+    // run length encoding, a control byte below 0x80 is followed by that
+    // many plus one bytes to copy, from 0x81 up it is followed by one byte
+    // to repeat the control byte minus 0x7E times
+    static size_t pack(const uint8_t* data, size_t size, uint8_t* packed);
+    // false if the packed bytes do not make exactly size bytes
+    static bool unpack(const uint8_t* packed, size_t length, uint8_t* data,
+                       size_t size);
+
+  private:
+    struct Slot {
+        uint32_t number;
+        Frame frame;
+    };
+
+    // body of the writer thread
+    void drain();
+    // encodes one frame against the last one written and writes it out
+    void write(const Slot& slot);
+
+    std::vector<Slot> m_ring;
+    // only the producer touches the frame count, head and tail are kept on
+    // cache lines of their own so the two threads do not fight over them
+    uint32_t m_frame;
+    alignas(64) std::atomic<size_t> m_head;
+    alignas(64) std::atomic<size_t> m_tail;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<bool> m_running;
+    std::FILE* m_file;
+    std::thread m_writer;
+    // only the writer touches these, the frame the next one is packed
+    // against, and when the last key frame was written
+    Frame m_previous;
+    uint32_t m_lastKey;
+    bool m_written;
+};
+
+#endif
@@ -7,45 +7,312 @@
 using Byte = unsigned char;
 using Opcode = unsigned short;
 
+#include <cstddef>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <string>
 #include <vector>
 
-class Chip {
-  public:
+#include "jit.hpp"
+#include "predecode.hpp"
+#include "profiler.hpp"
+#include "quirks.hpp"
+#include "tracer.hpp"
+
+class Analysis;
+
+// the ways an instruction can be executed, all of them produce the same
+// machine state
+enum class Engine {
+    // fetches and decodes every instruction through a nested switch
+    Switch,
+    // decodes each address once into a handler with extracted operands
+    Predecoded,
+    // runs translated native blocks, interpreting whatever is not translated
+    Jit
+};
+
+// where FX0A is in waiting for a key, it takes a press and then the release
+// of the same key before the program moves on
+enum class KeyWait : Byte { None, Press, Release };
+
+// the complete state of a machine, with no pointers or heap storage
+// copying one of these is a snapshot of the machine, and its bytes are the
+// payload of a save state
+struct ChipState {
     // 4KB memory, first 512 bytes are reserved
     // ROM is loaded after that
-    std::vector<Byte> m_memory;
+    Byte m_memory[4096];
     unsigned short m_programCounter;
     // stores a 12 bit address pointer
     unsigned short m_indexRegister;
     // V0 - VF
-    std::vector<Byte> m_registers;
+    Byte m_registers[16];
     // possibly 12 - 16 levels of pushing
-    std::vector<unsigned short> m_stack;
+    unsigned short m_stack[16];
     int m_stackPointer;
-    // 16 keys
-    std::vector<bool> m_keys;
-    // 32 rows, 64 columns
-    std::vector<bool> m_frameBuffer;
-    // count down at 60hz unless they are 0
+    // 16 keys, bit i is set while key i is held down
+    unsigned short m_keys;
+    // up to 64 rows of 128 columns, packed 64 pixels to a word with the
+    // leftmost pixel in the most significant bit
+    // at 64x32 the first 32 words are the rows, at 128x64 every row takes
+    // two words, either way the display is one line of pixels with each row
+    // following the last, which is what sprites wrap along
+    uint64_t m_frameBuffer[128];
+    // SUPER-CHIP 128x64 mode, switched with 00FF and 00FE
+    bool m_hires;
+    // count down at 60hz unless they are 0, see tickTimers()
     Byte m_delayTimer;
     Byte m_soundTimer;
+    // xorshift generator for CXNN, owned by each machine so instances never
+    // share or contend for one, and a run can be replayed from its seed
+    uint32_t m_randomSeed;
+    uint32_t m_randomState;
+    // SUPER-CHIP RPL user flags, saved and restored by FX75 and FX85 and
+    // kept across resets like the calculator kept them
+    Byte m_flags[8];
 
     // not part of chip8, useful for performance reasons
     // only draw when this flag is set
     bool m_drawFlag;
+    // FX0A halts the program until this is back to None
+    KeyWait m_keyWait;
+    // the key that was pressed, while waiting for its release
+    Byte m_waitKey;
+    // set by an illegal opcode, the program counter stays on it and the
+    // machine runs no further until it is reset
+    bool m_faulted;
+    // the opcode that faulted, for the host to report
+    Opcode m_faultOpcode;
+};
+
+// a save state is this header followed by the raw bytes of a ChipState
+// the layout is the host's, so states move between builds of the same
+// version on the same kind of machine
+struct SaveStateHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t size;
+};
+
+// bumped whenever ChipState changes
+#define SAVE_STATE_VERSION 6
+
+// everything an idle loop could change without writing to memory or the
+// display, taken at backward jumps during Chip::run()
+// when a loop comes back around to a mark with all of this unchanged and
+// nothing written in between, every later pass is the same until the host
+// changes the keys or the timers
+struct IdleMark {
+    unsigned short programCounter;
+    unsigned short indexRegister;
+    Byte registers[16];
+    unsigned short stack[16];
+    int stackPointer;
+    unsigned short keys;
+    Byte delayTimer;
+    Byte soundTimer;
+    KeyWait keyWait;
+    Byte waitKey;
+    uint32_t randomState;
+    // m_stores and the instructions run so far when the mark was taken
+    unsigned int stores;
+    int executed;
+    bool valid;
+};
+
+// why Chip::run() returned
+enum class StopReason {
+    BudgetExhausted,
+    // the display changed, only reported if m_drawFlag was clear
+    FrameDrawn,
+    // halted in FX0A, nothing runs until the keys let it continue, see
+    // Chip::keyWaitOver()
+    WaitingForKey,
+    // the program counter is left on the illegal opcode
+    IllegalOpcode,
+    // the sound timer went from 0 to running
+    SoundStarted
+};
+
+struct RunResult {
+    StopReason reason;
+    // instructions that were executed
+    int instructions;
+    // instructions of idle loops counted off the budget without being run,
+    // see IdleMark
+    int skipped;
+};
+
+class Chip : public ChipState {
+  public:
+    Engine m_engine;
+    // kept across resets, like the engine, and not part of save states
+    Quirks m_quirks;
+    // interpret() instantiated for m_quirks
+    void (Chip::*m_interpreter)();
+    // one decoded instruction per memory address, empty unless the
+    // predecoded engine is selected
+    std::vector<Instruction> m_decoded;
+    Jit m_jit;
+    // counts writes to memory and the display
+    unsigned int m_stores;
+    // a few marks so loops with more than one backward jump are still
+    // caught, picked by program counter
+    IdleMark m_idleMarks[4];
+    // whether run() counts idle loops off instead of running them, only
+    // worth turning off to time the engines themselves
+    bool m_fastForward;
+    // every instruction executed is recorded here while set, one at a time
+    // and with idle loops run in full, the tracer is not owned and must
+    // only be set on one machine at a time
+    Tracer* m_tracer;
 
     Chip();
 
     void debug_dumpMem();
     void debug_instructions(Opcode opcode);
 
+    // keeps the seed, so the random sequence starts over with the program
     void reset();
     void loadFont();
     bool loadROM(std::string filepath);
-    void play();
+    // loads an image already in memory, fails if it does not fit
+    bool loadROM(const Byte* image, size_t size);
+
+    // snapshots are a plain copy of the state
+    void saveState(ChipState& state) const;
+    void loadState(const ChipState& state);
+    // versioned save states, in memory or on disk
+    // saving to memory returns the number of bytes written, or 0 if the
+    // buffer is too small
+    static size_t saveStateSize();
+    size_t saveState(Byte* buffer, size_t capacity) const;
+    bool loadState(const Byte* buffer, size_t size);
+    bool saveState(const std::string& filepath) const;
+    bool loadState(const std::string& filepath);
+
+    // where FX30 finds the 8x10 digits, after the 4x5 ones at 0
+    static const int bigFontAddress = 0x50;
+
+    // I is 12 bits, and reads and writes from it that run past the end of
+    // memory wrap around to the start
+    static const unsigned short addressMask = 0x0FFF;
+    // return addresses the stack holds, a call with all of them in use or
+    // a return with none halts the machine like an illegal opcode
+    static const int stackDepth = 16;
+
+    // programs are loaded at 0x200 and run to the end of memory
+    static const size_t maxROMSize = 4096 - 0x200;
+
+    // instructions executed per 60hz frame unless the host asks otherwise,
+    // around 600 instructions per second
+    static const int defaultInstructionsPerFrame = 10;
+
+    // machines are seeded from the host's entropy source when created
+    void seedRandom(uint32_t seed);
+    uint32_t randomSeed() const { return m_randomSeed; }
+
+    static bool engineFromName(const std::string& name, Engine& engine);
+    void setEngine(Engine engine);
+    static bool quirksFromName(const std::string& name, Quirks& quirks);
+    // SUPER-CHIP if the analysis reached any SUPER-CHIP only opcode, Modern
+    // otherwise, the other profiles have to be asked for
+    static Quirks detectQuirks(const Analysis& analysis);
+    void setQuirks(Quirks quirks);
+    // decodes or translates all the code the analysis of the loaded ROM
+    // found for the selected engine, rather than when it is first reached
+    void pretranslate(const Analysis& analysis);
+    // translated blocks stop at maxInstructions, every other step is one
+    // instruction
+    int step(int maxInstructions = Jit::maxBlockInstructions);
+    // step() while a tracer is set
+    int stepTraced();
+    // steps until the budget is used up or something the host may want to
+    // react to happens, on every engine it stops exactly on the budget
+    // idle loops are counted through without being run, see IdleMark, and
+    // take up the budget as if they had
+    RunResult run(int maxInstructions);
+    // the length of the loop that just came back around to where it was
+    // with nothing changed, or 0, marking the current state in that case
+    int idleLoopLength(int executed);
+    void tickTimers();
+
+    // executes one instruction with the quirks of the current profile
+    void play() { (this->*m_interpreter)(); }
+    // the opcode at address, or 0000, which is illegal, past the last
+    // address a whole instruction can be fetched from
+    Opcode fetch(unsigned short address) const {
+        if (address > 0x0FFE)
+            return 0x0000;
+        return (Opcode)((m_memory[address] << 8) | m_memory[address + 1]);
+    }
+    template <class Policy> void interpret();
+    // where FX55 and FX65 leave I
+    template <class Policy> void advanceIndex(Byte X) {
+        if (Policy::index == IndexQuirk::PlusX)
+            m_indexRegister = (m_indexRegister + X) & addressMask;
+        else if (Policy::index == IndexQuirk::PlusXPlusOne)
+            m_indexRegister = (m_indexRegister + X + 1) & addressMask;
+    }
+    void playPredecoded();
+    // runs decoded instructions back to back, up to the budget or until
+    // one needs looking at, leaving pc at the last one executed
+    int playPredecoded(int maxInstructions, unsigned short& pc);
+    // runs translated blocks chained into each other up to the budget, at
+    // least one block or instruction, leaving pc at the last one executed
+    int playJit(int maxInstructions, unsigned short& pc);
+    // play() for the JIT engine, dropping translations of what it writes
+    void playJitFallback();
+    void invalidateDecoded();
+    void invalidateDecoded(unsigned short address, unsigned short length);
+
+    bool isKeyDown(Byte key) const {
+        return key < 16 && ((m_keys >> key) & 1);
+    }
+
+    // whether the current keys would let a halted FX0A move on, a host can
+    // sleep until its input changes while this is false
+    bool keyWaitOver() const {
+        switch (m_keyWait) {
+        case KeyWait::Press:
+            return m_keys != 0;
+        case KeyWait::Release:
+            return !isKeyDown(m_waitKey);
+        default:
+            return true;
+        }
+    }
+
+    Byte randomByte() {
+        uint32_t x = m_randomState;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        m_randomState = x;
+        return x >> 24;
+    }
+
+    int displayWidth() const { return m_hires ? 128 : 64; }
+    int displayHeight() const { return m_hires ? 64 : 32; }
+
+    bool getPixel(int x, int y) const {
+        int pixel = y * displayWidth() + x;
+        return (m_frameBuffer[pixel / 64] >> (63 - pixel % 64)) & 1;
+    }
+
+    // shared by all engines
+    void clearScreen();
+    // clipping sprites stop at the right and bottom edges, the others
+    // wrap along the display
+    template <bool clip> void drawSprite(Byte x, Byte y, Byte height);
+    void setHires(bool hires);
+    void scrollDown(Byte rows);
+    void scrollRight();
+    void scrollLeft();
+    void waitForKey(Byte X);
+    void illegalOpcode(Opcode opcode);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,14 @@
+#ifndef FRAME_HPP
+#define FRAME_HPP
+
+#include <cstdint>
+
+// a completed display handed from the emulation thread to whoever shows it
+// the layout matches Chip::m_frameBuffer, 64x32 uses the first 32 words one
+// row each, 128x64 uses all of them two words a row
+struct Frame {
+    uint64_t words[128];
+    bool hires;
+};
+
+#endif
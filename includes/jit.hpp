@@ -0,0 +1,103 @@
+#ifndef JIT_HPP
+#define JIT_HPP
+
+// included from chip.hpp, Byte and Opcode are defined there
+
+#include <cstddef>
+#include <vector>
+
+class Chip;
+struct JitContext;
+
+// native block, takes V0 - VF, with the rest of the machine state around
+// them, and the context it runs in
+// returns the next program counter in the low 16 bits, and the address of
+// the last instruction executed above that
+using JitBlock = unsigned int (*)(Byte* registers, JitContext* context);
+
+// what blocks share while they run, at rsi
+struct JitContext {
+    // the translation for each start address, or null
+    JitBlock* blocks;
+    // instructions left before blocks stop chaining, each block takes off
+    // the instructions it ran as it leaves
+    int budget;
+    // whether blocks chain on when they jump backwards, rather than
+    // returning so Chip::run() can look for an idle loop
+    bool backwards;
+    // set by FX33 and FX55, which end their block, length 0 otherwise
+    unsigned short writtenAddress;
+    unsigned short writtenLength;
+};
+
+// dynamic recompiler for x86-64
+// straight line runs of instructions are translated into native code the
+// first time the program counter reaches them, and the translation is
+// cached by its start address
+// blocks end at jumps, calls, returns and skips, which go straight on into
+// the block at their target while the budget lasts, and in front of
+// anything that draws, waits for a key, starts the sound or stops the
+// machine, which is left to Chip::play()
+// FX33 and FX55 end their block too, and drop the blocks they wrote over
+// a block returns in front of the first instruction the budget does not
+// cover, so a run stops on exactly the same instruction as the interpreters
+// and the rest of the block is entered there next time
+// on any other platform nothing gets translated and every instruction falls
+// back to the interpreter
+class Jit {
+  public:
+    Jit();
+    ~Jit();
+
+    // a copied machine starts with an empty cache of its own
+    Jit(const Jit& other);
+    Jit& operator=(const Jit& other);
+
+    static bool available();
+
+    // longest run of instructions in one block
+    static const int maxBlockInstructions = 64;
+
+    // runs the block starting at the program counter, translating it first
+    // if needed, and the blocks it leads to for as long as the budget lasts
+    // returns how many instructions were executed, and leaves last at the
+    // address of the last one
+    // 0 means the instruction at the program counter must be interpreted
+    int execute(Chip& chip, int maxInstructions, unsigned short& last);
+
+    // translates ahead of time the code from start up to end, which has to
+    // be a straight run only ever entered at start
+    void prepare(const Chip& chip, unsigned short start, unsigned short end);
+
+    // drops every translation
+    void flush();
+    // drops the translations that read anything in the range
+    void invalidate(unsigned short address, unsigned short length);
+
+  private:
+    // the bytes a translation was made from
+    struct Span {
+        unsigned short start;
+        unsigned short end;
+    };
+
+    // translations are tracked by the pages of memory they were read from
+    static const int pageSize = 256;
+
+    // count is set to the instructions the block covers
+    JitBlock translate(const Chip& chip, unsigned short address, int& count);
+    // allocates the tables on first use, false if nothing can be translated
+    bool ready();
+
+    Byte* m_code;
+    size_t m_codeUsed;
+    // set when no executable memory could be mapped
+    bool m_failed;
+    // translated block per start address, allocated on first use
+    std::vector<JitBlock> m_blocks;
+    // the translations read from each page
+    std::vector<std::vector<Span>> m_pages;
+    JitContext m_context;
+};
+
+#endif
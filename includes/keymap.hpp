@@ -0,0 +1,36 @@
+#ifndef KEYMAP_HPP
+#define KEYMAP_HPP
+
+#include <string>
+#include <vector>
+
+#include <SFML/Window.hpp>
+
+// maps host keyboard keys to the 16 CHIP-8 keys
+// the default layout is the left hand block of a QWERTY keyboard, a file
+// can rebind any key with lines of the form
+//     [CHIP-8 key in hex] [SFML key name]
+// e.g. "5 Up", everything after a # is a comment
+// Tab is rewind and can't be bound
+class Keymap {
+  public:
+    Keymap();
+
+    // leaves the keymap as it was unless the whole file is valid
+    bool loadFromFile(const std::string& filepath);
+
+    // the CHIP-8 key bound to a host key, or -1 if it isn't bound
+    int chipKey(sf::Keyboard::Key key) const {
+        if (key < 0 || key >= sf::Keyboard::KeyCount)
+            return -1;
+        return m_chipKeys[key];
+    }
+
+  private:
+    void bind(int chipKey, sf::Keyboard::Key key);
+
+    // indexed by sf::Keyboard::Key
+    std::vector<int> m_chipKeys;
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef LOCKSTEP_HPP
+#define LOCKSTEP_HPP
+
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "chip.hpp"
+
+// runs many copies of one machine side by side, one per lane
+// V0 - VF, I and the program counter of every lane are kept as one array
+// per register, lane after lane
+// lanes are grouped by their program counter, so an instruction that
+// several lanes are on is decoded once and executed by one loop over just
+// the lanes in its group, a vectorized one when the group is every lane
+// groups take turns, the lowest program counter first, which is where lanes
+// that went different ways at a skip meet up again
+// memory, the stack, the display, timers and keys stay in each lane's Chip,
+// and instructions using them are executed against it lane by lane
+// the few instructions left, and code that some lane has written over, run
+// through Chip::step(), so every lane does exactly what a lone Chip would
+class Lockstep {
+  public:
+    // every lane starts out as a copy of prototype
+    Lockstep(const Chip& prototype, size_t lanes);
+
+    size_t lanes() const { return m_machines.size(); }
+    // the machine in a lane, up to date whenever run() is not executing
+    Chip& machine(size_t lane) { return m_machines[lane]; }
+
+    // runs every lane for up to maxInstructions, a lane stops early when it
+    // faults or waits for a key, and returns how many instructions ran in
+    // all lanes together
+    // drawing does not stop a lane, m_drawFlag is left set for the host
+    long long run(int maxInstructions);
+    void tickTimers();
+
+  private:
+    Byte* registers(int index) { return &m_registers[index * lanes()]; }
+
+    // moves V0 - VF, I and the program counter between the lanes' Chips
+    // and the arrays
+    void load(size_t lane);
+    void store(size_t lane);
+
+    // puts a lane with instructions left into the group at its program
+    // counter
+    void join(unsigned int lane);
+    // a group that holds every lane, walked in lane order rather than
+    // through its list, so the loops over the register arrays are over
+    // contiguous lanes and get vectorized
+    struct LaneCounter {
+        unsigned int lane;
+        unsigned int operator*() const { return lane; }
+        LaneCounter& operator++() {
+            lane++;
+            return *this;
+        }
+        bool operator!=(const LaneCounter& other) const {
+            return lane != other.lane;
+        }
+    };
+    struct AllLanes {
+        unsigned int count;
+        LaneCounter begin() const { return {0}; }
+        LaneCounter end() const { return {count}; }
+    };
+
+    // executes opcode in every lane of the group, either m_active or
+    // AllLanes, returns false if it has to be interpreted instead
+    template <class Lanes> bool execute(Opcode opcode, const Lanes& group);
+    // interprets the next instruction of one lane
+    void interpret(size_t lane);
+    // marks memory a lane wrote as no longer the same in every lane
+    void written(unsigned short address, int length);
+    template <class Lanes> void advanceIndex(Byte X, const Lanes& group);
+
+    std::vector<Chip> m_machines;
+    // V0 of every lane, then V1 of every lane, and so on
+    std::vector<Byte> m_registers;
+    std::vector<unsigned short> m_indexRegister;
+    std::vector<unsigned short> m_programCounter;
+    // instructions each lane has left in this run()
+    std::vector<int> m_remaining;
+    // the lanes on each program counter, with one group at the end for
+    // every lane that went past the end of memory
+    std::vector<std::vector<unsigned int>> m_groups;
+    // the program counters with a group waiting, lowest on top
+    std::priority_queue<int, std::vector<int>, std::greater<int>> m_pending;
+    // the group executing the current instruction
+    std::vector<unsigned int> m_active;
+    // memory as the prototype had it, and which bytes no lane has written
+    // since, only those can be decoded once for all lanes
+    std::vector<Byte> m_code;
+    std::vector<bool> m_shared;
+    // the prototype's profile, every lane runs with it
+    QuirkSet m_quirks;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef PREDECODE_HPP
+#define PREDECODE_HPP
+
+// included from chip.hpp, Byte and Opcode are defined there
+
+class Chip;
+struct Instruction;
+enum class Quirks : Byte;
+
+// executes one decoded instruction, including the program counter update
+// returns false if it may have drawn, started the sound, halted the machine
+// or jumped back to where a loop could close, so the caller has to look,
+// see Chip::m_fastForward
+using Handler = bool (*)(Chip& chip, const Instruction& instruction);
+
+// an instruction with its operands already pulled out of the opcode
+struct Instruction {
+    Handler handler;
+    Opcode opcode;
+    Byte X;
+    Byte Y;
+    Byte N;
+    Byte NN;
+    unsigned short NNN;
+};
+
+// the handler every table entry starts with, it decodes the opcode at the
+// program counter, stores the result and runs it
+bool decodeAndExecute(Chip& chip, const Instruction& instruction);
+
+// handlers are picked for the given quirks profile
+Instruction decode(Opcode opcode, Quirks quirks);
+
+// false for opcodes that stop the machine, which they do under every
+// profile
+bool legal(Opcode opcode);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+// included from chip.hpp, Byte and Opcode are defined there
+
+#include <cstdint>
+
+// per opcode execution profile, only compiled in with -DCHIPPER_PROFILE
+// every step counts its instructions and the host cycles it took against
+// the class of the opcode at the program counter and against the program
+// counter itself, blocks the jit ran natively are counted as one class of
+// their own
+// the report goes to stderr when the program exits, or whenever it receives
+// SIGUSR1
+// without the define the macros expand to nothing and none of this exists
+// in the build
+#ifdef CHIPPER_PROFILE
+
+class Profiler {
+  public:
+    // host cycle counter, the time stamp counter where there is one
+    static uint64_t now();
+    static void record(unsigned short pc, Opcode opcode, int instructions,
+                       uint64_t cycles);
+    static void report();
+};
+
+#define PROFILE_BEGIN(chip)                                                   \
+    unsigned short profilePc = (chip).m_programCounter;                      \
+    Opcode profileOpcode = (chip).fetch(profilePc);                          \
+    uint64_t profileStart = Profiler::now()
+#define PROFILE_END(instructions)                                             \
+    Profiler::record(profilePc, profileOpcode, (instructions),                \
+                     Profiler::now() - profileStart)
+
+#else
+
+#define PROFILE_BEGIN(chip)
+#define PROFILE_END(instructions)
+
+#endif
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef QUIRKS_HPP
+#define QUIRKS_HPP
+
+// included from chip.hpp, Byte is defined there
+
+// the behaviours CHIP-8 interpreters disagree on, grouped into the profiles
+// of the interpreters ROMs were written for
+// each profile is a policy class of compile time constants, the switch and
+// predecoded engines are instantiated once per profile so none of them is
+// checked while a ROM runs
+enum class Quirks : Byte { Modern, CosmacVip, Chip48, SuperChip };
+
+// what FX55 and FX65 leave in I
+enum class IndexQuirk : Byte { Kept, PlusX, PlusXPlusOne };
+
+// what CHIPPER has always done
+struct ModernQuirks {
+    // 8XY1, 8XY2 and 8XY3 clear VF
+    static constexpr bool resetVF = true;
+    // 8XY6 and 8XYE shift VY into VX rather than shifting VX in place
+    static constexpr bool shiftVY = false;
+    static constexpr IndexQuirk index = IndexQuirk::Kept;
+    // BNNN jumps to NNN plus VX, X being the top digit of NNN, not V0
+    static constexpr bool jumpVX = false;
+    // DXYN cuts sprites off at the edges rather than wrapping them
+    static constexpr bool clipSprites = false;
+};
+
+// the original COSMAC VIP interpreter
+struct CosmacVipQuirks {
+    static constexpr bool resetVF = true;
+    static constexpr bool shiftVY = true;
+    static constexpr IndexQuirk index = IndexQuirk::PlusXPlusOne;
+    static constexpr bool jumpVX = false;
+    static constexpr bool clipSprites = true;
+};
+
+// CHIP-48 on the HP48
+struct Chip48Quirks {
+    static constexpr bool resetVF = false;
+    static constexpr bool shiftVY = false;
+    static constexpr IndexQuirk index = IndexQuirk::PlusX;
+    static constexpr bool jumpVX = true;
+    static constexpr bool clipSprites = true;
+};
+
+// SUPER-CHIP 1.1
+struct SuperChipQuirks {
+    static constexpr bool resetVF = false;
+    static constexpr bool shiftVY = false;
+    static constexpr IndexQuirk index = IndexQuirk::Kept;
+    static constexpr bool jumpVX = true;
+    static constexpr bool clipSprites = true;
+};
+
+// the same constants as values, for code that picks a behaviour while
+// translating rather than while compiling
+struct QuirkSet {
+    bool resetVF;
+    bool shiftVY;
+    IndexQuirk index;
+    bool jumpVX;
+    bool clipSprites;
+};
+
+template <class Policy> constexpr QuirkSet quirkSetOf() {
+    return {Policy::resetVF, Policy::shiftVY, Policy::index, Policy::jumpVX,
+            Policy::clipSprites};
+}
+
+inline QuirkSet quirkSet(Quirks quirks) {
+    switch (quirks) {
+    case Quirks::CosmacVip:
+        return quirkSetOf<CosmacVipQuirks>();
+    case Quirks::Chip48:
+        return quirkSetOf<Chip48Quirks>();
+    case Quirks::SuperChip:
+        return quirkSetOf<SuperChipQuirks>();
+    case Quirks::Modern:
+    default:
+        return quirkSetOf<ModernQuirks>();
+    }
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef RENDERER_HPP
+#define RENDERER_HPP
+
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "frame.hpp"
+
+// draws the display as a single scaled texture
+// the texture is always 128x64, in the 64x32 mode every pixel covers 2x2
+// texels
+// the texture lives on the GPU and only the rows that changed since the last
+// update are uploaded again
+class Renderer {
+  public:
+    // pixelScale is the size of a 128x64 pixel on screen, 64x32 pixels are
+    // twice as big so both modes fill the same area
+    Renderer(int pixelScale, sf::Color primaryColor, sf::Color secondaryColor);
+
+    // the size of the scaled display, for the window to fit it exactly
+    sf::Vector2u size() const {
+        return m_texture.getSize() * (unsigned int)m_pixelScale;
+    }
+
+    // uploads every row that differs from the last frame shown, in one go
+    // frames can be skipped in between, so rows are compared rather than
+    // tracked as they get drawn, and a change of mode redraws everything
+    void update(const Frame& frame);
+    void draw(sf::RenderTarget& target) const;
+
+  private:
+    // the bits of display row y as texels, doubled up in the 64x32 mode
+    bool rowChanged(const Frame& frame, int row) const;
+    void fillRow(const Frame& frame, int row);
+
+    int m_pixelScale;
+    sf::Color m_primaryColor;
+    sf::Color m_secondaryColor;
+    // the rows currently in the texture
+    Frame m_shown;
+    // RGBA copy of the display, the source of every texture upload
+    std::vector<sf::Uint8> m_pixels;
+    sf::Texture m_texture;
+    sf::Sprite m_sprite;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef REWIND_HPP
+#define REWIND_HPP
+
+#include <vector>
+
+#include "chip.hpp"
+
+// history of machine states for stepping backwards in time
+// one state is captured per frame, as the frame starts, into a ring of
+// fixed size, the oldest frames falling off the end
+// a keyframe is stored every keyframeInterval frames and every other frame
+// only stores its xor against the latest keyframe, run length encoded, which
+// comes down to a few bytes when little changed
+class Rewind {
+  public:
+    Rewind(int frames = 60 * 60, int keyframeInterval = 120);
+
+    void capture(const ChipState& state);
+    // removes the newest frame and writes it to state
+    // returns false once the history is used up
+    bool stepBack(ChipState& state);
+    void clear();
+
+    int frames() const { return m_count; }
+    // bytes held by encoded frames
+    size_t memoryUsed() const;
+
+  private:
+    struct Entry {
+        // frames since this frame's keyframe, 0 for a keyframe itself
+        int keyframeDistance;
+        std::vector<Byte> data;
+    };
+
+    static void encode(const Byte* state, const Byte* base,
+                       std::vector<Byte>& out);
+    static void decode(const std::vector<Byte>& in, const Byte* base,
+                       Byte* state);
+    void decodeKeyframe(int slot, ChipState& state) const;
+
+    std::vector<Entry> m_entries;
+    int m_keyframeInterval;
+    // oldest frame and number of frames in the ring
+    int m_first;
+    int m_count;
+    // the keyframe the next capture is encoded against
+    ChipState m_keyframe;
+    ChipState m_zero;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef ROMLIBRARY_HPP
+#define ROMLIBRARY_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "analysis.hpp"
+#include "chip.hpp"
+
+struct RomEntry {
+    std::string name;
+    // fnv-1a of the image, identifies a ROM whatever its file is called
+    uint64_t hash;
+    // false if the image is too large to be loaded
+    bool fits;
+    // the profile the ROM is run with, see Chip::detectQuirks()
+    Quirks quirks;
+    std::vector<Byte> image;
+    // made once while scanning, empty for images that do not fit
+    Analysis analysis;
+};
+
+// every ROM in a directory, read from disk once when the library is built
+// loading, resetting and switching between ROMs afterwards only copies the
+// cached image into memory
+// builds with CHIPPER_EMBED_ROMS take the ROMs from the pack compiled into
+// them instead, see packroms, and never read the directory
+class RomLibrary {
+  public:
+    // indexes every regular file in the directory apart from its README,
+    // sorted by name, or the embedded pack if there is one with any ROMs
+    bool scan(const std::string& directory);
+
+    size_t size() const { return m_entries.size(); }
+    const RomEntry& operator[](size_t index) const {
+        return m_entries[index];
+    }
+    // index of the ROM with this name, or -1
+    int find(const std::string& name) const;
+    // the next ROM that fits, stepping forwards or backwards and wrapping
+    // around, or from itself if none other does
+    int next(int index, int direction) const;
+
+    // runs every ROM with this profile rather than the one detected
+    void setQuirks(Quirks quirks);
+
+    // copies the image into a machine that has been reset, selects the
+    // ROM's quirks profile and prepares its code for the selected engine
+    // returns the analysis the code was prepared from, for the caller to
+    // act on what it found, or null if the image does not fit
+    const Analysis* load(Chip& chip, size_t index) const;
+
+  private:
+    // hashes and analyses an image and adds it to the end
+    void add(const std::string& name, std::vector<Byte> image);
+
+    std::vector<RomEntry> m_entries;
+};
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef ROMPACK_HPP
+#define ROMPACK_HPP
+
+#include <cstddef>
+
+// ROM images compiled into the binary, see packroms
+// only builds with CHIPPER_EMBED_ROMS defined link a pack in
+struct EmbeddedRom {
+    const char* name;
+    const unsigned char* image;
+    size_t size;
+};
+
+// sorted by name
+extern const EmbeddedRom embeddedRoms[];
+extern const size_t embeddedRomCount;
+
+#endif
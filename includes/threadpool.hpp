@@ -0,0 +1,56 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// a small work-stealing thread pool
+// every worker owns a deque of tasks, pops from the back of its own deque and
+// steals from the front of the others when it runs dry
+class ThreadPool {
+  public:
+    using Task = std::function<void()>;
+
+    explicit ThreadPool(unsigned int threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned int size() const { return (unsigned int)m_workers.size(); }
+
+    void submit(Task task);
+    // blocks until every submitted task has finished
+    void wait();
+
+  private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    bool popLocal(unsigned int index, Task& task);
+    bool steal(unsigned int thief, Task& task);
+    void workerLoop(unsigned int index);
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_workers;
+    std::atomic<unsigned int> m_nextQueue;
+
+    // queued counts tasks waiting in a deque, pending also counts the ones
+    // that are currently running
+    std::mutex m_stateLock;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_allDone;
+    unsigned int m_queued;
+    unsigned int m_pending;
+    bool m_stopping;
+};
+
+#endif
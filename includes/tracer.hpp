@@ -0,0 +1,105 @@
+#ifndef TRACER_HPP
+#define TRACER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// one executed instruction as it is stored in a trace file
+struct TraceRecord {
+    // instructions executed since tracing started, dropped ones included
+    uint64_t cycle;
+    uint16_t pc;
+    uint16_t opcode;
+    // I after the instruction
+    uint16_t index;
+    // the lowest numbered register the instruction changed, noRegister if
+    // none did, and its new value
+    uint8_t reg;
+    uint8_t value;
+};
+
+static_assert(sizeof(TraceRecord) == 16, "trace records are 16 bytes");
+
+#define TRACE_LOAD_ERR -3
+
+// trace files start with this, followed by records up to the end of the file
+#define TRACE_VERSION 1
+struct TraceHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t recordSize;
+};
+
+// records every instruction a machine executes into a file
+// the machine appends to a ring buffer and a writer thread drains it to the
+// file in large blocks, so the emulation thread never waits on the disk
+// the ring has exactly one producer and one consumer and needs no locks
+// if the writer falls behind, records are dropped rather than slowing the
+// machine down, and the gap shows in the cycle numbers
+class Tracer {
+  public:
+    static const uint8_t noRegister = 0xFF;
+
+    // capacity is in records and is rounded up to a power of two
+    explicit Tracer(size_t capacity = 1 << 16);
+    ~Tracer();
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    // truncates the file, writes the header and starts the writer
+    bool start(const std::string& path);
+    // writes out whatever is still in the ring and closes the file
+    void stop();
+    bool active() const { return m_file != nullptr; }
+    uint64_t dropped() const { return m_dropped.load(); }
+
+    // called after every instruction with the registers from before and
+    // after it, only ever from one thread
+    void record(uint16_t pc, uint16_t opcode, uint16_t index,
+                const uint8_t* before, const uint8_t* after) {
+        uint64_t cycle = m_cycle++;
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) == m_ring.size()) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        TraceRecord& record = m_ring[head & (m_ring.size() - 1)];
+        record.cycle = cycle;
+        record.pc = pc;
+        record.opcode = opcode;
+        record.index = index;
+        record.reg = noRegister;
+        record.value = 0;
+        for (int i = 0; i < 16; i++) {
+            if (before[i] != after[i]) {
+                record.reg = (uint8_t)i;
+                record.value = after[i];
+                break;
+            }
+        }
+        m_head.store(head + 1, std::memory_order_release);
+    }
+
+  private:
+    // body of the writer thread
+    void drain();
+
+    std::vector<TraceRecord> m_ring;
+    // only the producer touches the cycle count, head and tail are kept on
+    // cache lines of their own so the two threads do not fight over them
+    uint64_t m_cycle;
+    alignas(64) std::atomic<size_t> m_head;
+    alignas(64) std::atomic<size_t> m_tail;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<bool> m_running;
+    std::FILE* m_file;
+    std::thread m_writer;
+};
+
+#endif
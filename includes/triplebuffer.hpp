@@ -0,0 +1,51 @@
+#ifndef TRIPLEBUFFER_HPP
+#define TRIPLEBUFFER_HPP
+
+#include <atomic>
+
+// lock-free handoff of the latest value from one writer thread to one reader
+// thread
+// the writer and the reader each own one buffer and the third sits in the
+// middle, publishing and picking up are a single atomic swap with the
+// middle one, so neither side ever waits and the reader always sees a
+// complete value
+template <class T> class TripleBuffer {
+  public:
+    TripleBuffer() : m_write(0), m_middle(1), m_read(2) {}
+
+    // the buffer the writer fills next
+    T& writeBuffer() { return m_buffers[m_write]; }
+
+    // makes the write buffer the newest value
+    // returns true if the value it replaces was never picked up
+    bool publish() {
+        unsigned int previous =
+            m_middle.exchange(m_write | freshBit, std::memory_order_acq_rel);
+        m_write = previous & indexMask;
+        return (previous & freshBit) != 0;
+    }
+
+    // takes the newest value if one was published since the last call
+    bool update() {
+        if (!(m_middle.load(std::memory_order_relaxed) & freshBit))
+            return false;
+        unsigned int previous =
+            m_middle.exchange(m_read, std::memory_order_acq_rel);
+        m_read = previous & indexMask;
+        return true;
+    }
+
+    // the value the reader picked up last
+    const T& readBuffer() const { return m_buffers[m_read]; }
+
+  private:
+    static const unsigned int indexMask = 0x3;
+    static const unsigned int freshBit = 0x4;
+
+    T m_buffers[3];
+    unsigned int m_write;
+    std::atomic<unsigned int> m_middle;
+    unsigned int m_read;
+};
+
+#endif
@@ -0,0 +1,262 @@
+#include <algorithm>
+
+#include "../includes/analysis.hpp"
+
+// I as far as the analysis knows it, anything 0x1000 and up is not an
+// address
+// not reached yet, merges into whatever comes in
+static const unsigned short unreached = 0xFFFF;
+// different on different paths, or computed
+static const unsigned short unknown = 0xFFFE;
+
+// where execution can go after the instruction at address, returns true if
+// the instruction ends its block
+static bool flow(unsigned short address, Opcode opcode,
+                 std::vector<unsigned short>& next) {
+    next.clear();
+    if (!legal(opcode))
+        return true;
+    unsigned short NNN = opcode & 0x0FFF;
+    switch (opcode & 0xF000) {
+    case 0x0000:
+        if (opcode == 0x00EE || opcode == 0x00FD)
+            return true;
+        next.push_back(address + 2);
+        return false;
+    case 0x1000:
+        next.push_back(NNN);
+        return true;
+    case 0x2000:
+        next.push_back(NNN);
+        next.push_back(address + 2);
+        return true;
+    case 0x3000:
+    case 0x4000:
+    case 0x5000:
+    case 0x9000:
+    case 0xE000:
+        next.push_back(address + 2);
+        next.push_back(address + 4);
+        return true;
+    case 0xB000:
+        return true;
+    default:
+        next.push_back(address + 2);
+        return false;
+    }
+}
+
+// the walk is over byte addresses, so code at odd addresses and
+// instructions overlapping each other are followed like any other
+Analysis::Analysis(const Byte* image, size_t size)
+    : m_image(image, image + size), m_use(size, 0), m_selfModifying(false) {
+    std::vector<bool> leader(size, false);
+    std::vector<unsigned short> pending;
+    std::vector<unsigned short> next;
+    if (inside(0x201)) {
+        leader[0] = true;
+        pending.push_back(0x200);
+    }
+
+    while (!pending.empty()) {
+        unsigned short address = pending.back();
+        pending.pop_back();
+        if (m_use[address - 0x200] & instruction)
+            continue;
+        m_use[address - 0x200] |= instruction | code;
+        if (inside(address + 1))
+            m_use[address + 1 - 0x200] |= code;
+        m_instructions.push_back(address);
+
+        Opcode op = opcode(address);
+        bool ends = flow(address, op, next);
+        if (!legal(op))
+            m_illegal.push_back(address);
+        else if ((op & 0xF000) == 0xB000)
+            m_indirect.push_back(address);
+        bool escapes = false;
+        for (unsigned short target : next) {
+            // the last byte of the image cannot hold a whole instruction
+            if (!inside(target) || !inside(target + 1)) {
+                escapes = true;
+                continue;
+            }
+            if (ends)
+                leader[target - 0x200] = true;
+            pending.push_back(target);
+        }
+        if (escapes)
+            m_escapes.push_back(address);
+    }
+    std::sort(m_instructions.begin(), m_instructions.end());
+    std::sort(m_illegal.begin(), m_illegal.end());
+    std::sort(m_escapes.begin(), m_escapes.end());
+    std::sort(m_indirect.begin(), m_indirect.end());
+
+    // every reachable instruction is a leader or follows on from one, and
+    // a block runs until it meets the next leader
+    for (unsigned short start : m_instructions) {
+        if (!leader[start - 0x200])
+            continue;
+        Block block;
+        block.start = start;
+        unsigned short address = start;
+        while (true) {
+            bool ends = flow(address, opcode(address), next);
+            address += 2;
+            if (ends || !inside(address) || !inside(address + 1) ||
+                leader[address - 0x200]) {
+                if (!ends)
+                    next = {address};
+                break;
+            }
+        }
+        block.end = address;
+        for (unsigned short target : next)
+            if (inside(target) && inside(target + 1))
+                block.successors.push_back(target);
+        m_blocks.push_back(block);
+    }
+
+    followIndex();
+    for (size_t i = 0; i < m_blocks.size(); i++)
+        markData(m_blocks[i], m_entryIndex[i]);
+    for (Byte use : m_use)
+        if ((use & code) && (use & written))
+            m_selfModifying = true;
+}
+
+Opcode Analysis::opcode(unsigned short address) const {
+    Byte high = inside(address) ? m_image[address - 0x200] : 0;
+    Byte low = inside(address + 1) ? m_image[address + 1 - 0x200] : 0;
+    return (Opcode)((high << 8) | low);
+}
+
+// whether an instruction can leave I changed, FX55 and FX65 move it under
+// some profiles
+static bool writesIndex(Opcode opcode) {
+    if ((opcode & 0xF000) == 0xA000)
+        return true;
+    if ((opcode & 0xF000) != 0xF000)
+        return false;
+    switch (opcode & 0x00FF) {
+    case 0x1E:
+    case 0x29:
+    case 0x30:
+    case 0x55:
+    case 0x65:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// I after an instruction, given I before it
+static unsigned short nextIndex(Opcode opcode, unsigned short index) {
+    if ((opcode & 0xF000) == 0xA000)
+        return opcode & 0x0FFF;
+    return writesIndex(opcode) ? unknown : index;
+}
+
+bool Analysis::keepsIndex(const std::vector<int>& blockAt,
+                          unsigned short subroutine) const {
+    std::vector<bool> visited(m_blocks.size(), false);
+    std::vector<int> pending = {blockAt[subroutine - 0x200]};
+    while (!pending.empty()) {
+        int current = pending.back();
+        pending.pop_back();
+        if (visited[current])
+            continue;
+        visited[current] = true;
+        const Block& block = m_blocks[current];
+        for (unsigned short address = block.start; address < block.end;
+             address += 2)
+            if (writesIndex(opcode(address)))
+                return false;
+        for (unsigned short target : block.successors)
+            pending.push_back(blockAt[target - 0x200]);
+    }
+    return true;
+}
+
+// a forward data flow pass to a fixed point, blocks reached with different
+// values of I see it as unknown
+// the machine starts with I at 0
+void Analysis::followIndex() {
+    m_entryIndex.assign(m_blocks.size(), unreached);
+    if (m_blocks.empty())
+        return;
+    std::vector<int> blockAt(m_image.size(), -1);
+    for (size_t i = 0; i < m_blocks.size(); i++)
+        blockAt[m_blocks[i].start - 0x200] = (int)i;
+    // whether each block is a call that comes back with I as it was
+    std::vector<bool> transparent(m_blocks.size(), false);
+    for (size_t i = 0; i < m_blocks.size(); i++) {
+        Opcode last = opcode(m_blocks[i].end - 2);
+        unsigned short target = last & 0x0FFF;
+        if ((last & 0xF000) == 0x2000 && inside(target) &&
+            inside(target + 1))
+            transparent[i] = keepsIndex(blockAt, target);
+    }
+
+    m_entryIndex[0] = 0;
+    std::vector<int> pending = {0};
+    while (!pending.empty()) {
+        int current = pending.back();
+        pending.pop_back();
+        const Block& block = m_blocks[current];
+        unsigned short index = m_entryIndex[current];
+        for (unsigned short address = block.start; address < block.end;
+             address += 2)
+            index = nextIndex(opcode(address), index);
+
+        bool call = (opcode(block.end - 2) & 0xF000) == 0x2000;
+        for (unsigned short target : block.successors) {
+            // unless the subroutine cannot change I, it may come back with
+            // anything in it
+            unsigned short incoming =
+                call && target == block.end && !transparent[current]
+                    ? unknown
+                    : index;
+            int successor = blockAt[target - 0x200];
+            unsigned short& entry = m_entryIndex[successor];
+            unsigned short merged = entry == unreached ? incoming
+                                    : entry == incoming ? entry
+                                                        : unknown;
+            if (merged != entry) {
+                entry = merged;
+                pending.push_back(successor);
+            }
+        }
+    }
+}
+
+void Analysis::markData(const Block& block, unsigned short index) {
+    for (unsigned short address = block.start; address < block.end;
+         address += 2) {
+        Opcode op = opcode(address);
+        Byte X = (op & 0x0F00) >> 8;
+        Byte use = 0;
+        int length = 0;
+        if ((op & 0xF000) == 0xD000) {
+            // DXY0 is a 16x16 sprite of 32 bytes in 128x64 mode, and
+            // draws nothing otherwise
+            use = data;
+            length = (op & 0x000F) ? op & 0x000F : 32;
+        } else if ((op & 0xF0FF) == 0xF065) {
+            use = data;
+            length = X + 1;
+        } else if ((op & 0xF0FF) == 0xF055) {
+            use = written;
+            length = X + 1;
+        } else if ((op & 0xF0FF) == 0xF033) {
+            use = written;
+            length = 3;
+        }
+        if (use && index < 0x1000)
+            for (int i = 0; i < length; i++)
+                if (inside(index + i))
+                    m_use[index + i - 0x200] |= use;
+        index = nextIndex(op, index);
+    }
+}
@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+
+#include "../includes/chip.hpp"
+#include "../includes/lockstep.hpp"
+#include "../includes/romlibrary.hpp"
+#include "../includes/threadpool.hpp"
+
+// headless batch runner
+// runs many independent CHIP-8 instances across all cores and reports the
+// aggregate throughput, no window, input or sound involved
+
+int main(int argc, char* argv[]) {
+    // engine=name, ipf=count, seed=number, lanes=count and quirks=name may
+    // appear anywhere, the rest is positional
+    Engine engine = Engine::Switch;
+    int instructionsPerFrame = Chip::defaultInstructionsPerFrame;
+    // instances of the same ROM run this many at a time in lockstep, 1 runs
+    // each on its own
+    int lanes = 1;
+    // overrides the profile detected for each ROM
+    bool quirksGiven = false;
+    Quirks quirks = Quirks::Modern;
+    // instance i is seeded with seed + i, printed so a run can be replayed
+    uint32_t seed = std::random_device()();
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg.rfind("engine=", 0) == 0) {
+            if (!Chip::engineFromName(arg.substr(7), engine)) {
+                std::cout << "Unknown engine " << arg.substr(7) << "\n";
+                exit(ROM_LOAD_ERR);
+            }
+        } else if (arg.rfind("ipf=", 0) == 0) {
+            instructionsPerFrame =
+                std::max(1, std::atoi(arg.substr(4).c_str()));
+        } else if (arg.rfind("seed=", 0) == 0) {
+            seed = (uint32_t)std::stoul(arg.substr(5));
+        } else if (arg.rfind("quirks=", 0) == 0) {
+            if (!Chip::quirksFromName(arg.substr(7), quirks)) {
+                std::cout << "Unknown quirks " << arg.substr(7) << "\n";
+                exit(ROM_LOAD_ERR);
+            }
+            quirksGiven = true;
+        } else if (arg.rfind("lanes=", 0) == 0) {
+            lanes = std::max(1, std::atoi(arg.substr(6).c_str()));
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    if (args.empty()) {
+        std::cout << "Usage: ./batch [ROM name | all] [?instances] "
+                     "[?instructions per instance] [?threads] "
+                     "[?engine=switch|predecoded|jit] [?ipf=count] "
+                     "[?seed=number] [?lanes=count] "
+                     "[?quirks=modern|vip|chip48|schip]\n";
+        exit(ROM_LOAD_ERR);
+    }
+
+    std::string romName = args[0];
+    long instances = args.size() > 1 ? std::stol(args[1]) : 1000;
+    long instructions = args.size() > 2 ? std::stol(args[2]) : 100000;
+    unsigned int threads =
+        args.size() > 3 ? (unsigned int)std::stoul(args[3])
+                        : std::max(1u, std::thread::hardware_concurrency());
+
+    RomLibrary library;
+    if (!library.scan("./roms/"))
+        exit(ROM_LOAD_ERR);
+    if (quirksGiven)
+        library.setQuirks(quirks);
+    std::vector<size_t> roms;
+    if (romName == "all") {
+        for (size_t i = 0; i < library.size(); i++)
+            if (library[i].fits)
+                roms.push_back(i);
+    } else {
+        int rom = library.find(romName);
+        if (rom < 0) {
+            std::cerr << "Failed to load ROM\n";
+            exit(ROM_LOAD_ERR);
+        }
+        roms.push_back(rom);
+    }
+
+    // instances are copies of one loaded machine per ROM
+    std::vector<Chip> prototypes(roms.size());
+    for (size_t i = 0; i < roms.size(); i++) {
+        prototypes[i].setEngine(engine);
+        const Analysis* analysis = library.load(prototypes[i], roms[i]);
+        if (!analysis)
+            exit(ROM_LOAD_ERR);
+        // such instances may well end up counted under Faults
+        if (!analysis->illegal().empty())
+            std::cout << "Warning: " << library[roms[i]].name
+                      << " can reach an illegal opcode at 0x" << std::hex
+                      << analysis->illegal()[0] << std::dec << "\n";
+    }
+
+    std::atomic<long long> totalInstructions(0);
+    std::atomic<long long> totalSkipped(0);
+    std::atomic<long long> totalFrames(0);
+    std::atomic<long long> totalDraws(0);
+    std::atomic<long long> totalFaults(0);
+    std::atomic<long long> totalWaiting(0);
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        ThreadPool pool(threads);
+        // instance i runs ROM i % ROMs, lanes are filled with consecutive
+        // instances of the same ROM
+        for (size_t rom = 0; lanes > 1 && rom < roms.size(); rom++) {
+            for (long first = rom; first < instances;
+                 first += (long)roms.size() * lanes) {
+                std::vector<long> group;
+                for (long i = first;
+                     i < instances && (int)group.size() < lanes;
+                     i += (long)roms.size())
+                    group.push_back(i);
+                const Chip& prototype = prototypes[rom];
+                pool.submit([&prototype, group, seed, instructions,
+                             instructionsPerFrame, &totalInstructions,
+                             &totalFrames, &totalDraws, &totalFaults,
+                             &totalWaiting] {
+                    Lockstep lockstep(prototype, group.size());
+                    for (size_t lane = 0; lane < group.size(); lane++) {
+                        uint32_t laneSeed = seed + (uint32_t)group[lane];
+                        lockstep.machine(lane).seedRandom(laneSeed);
+                    }
+                    long long executed = 0;
+                    long long frames = 0;
+                    long long draws = 0;
+                    // lanes stop under the same conditions as a lone
+                    // instance below
+                    std::vector<bool> stopped(group.size(), false);
+                    size_t running = group.size();
+                    for (long long frame = 0;
+                         frame * instructionsPerFrame < instructions &&
+                         running > 0;
+                         frame++) {
+                        executed += lockstep.run(instructionsPerFrame);
+                        lockstep.tickTimers();
+                        for (size_t lane = 0; lane < group.size(); lane++) {
+                            Chip& chip = lockstep.machine(lane);
+                            if (stopped[lane])
+                                continue;
+                            frames++;
+                            // every frame that drew counts once
+                            if (chip.m_drawFlag) {
+                                draws++;
+                                chip.m_drawFlag = false;
+                            }
+                            if (chip.m_faulted) {
+                                totalFaults++;
+                            } else if (!chip.keyWaitOver() &&
+                                       chip.m_delayTimer == 0 &&
+                                       chip.m_soundTimer == 0) {
+                                totalWaiting++;
+                            } else {
+                                continue;
+                            }
+                            stopped[lane] = true;
+                            running--;
+                        }
+                    }
+                    totalInstructions += executed;
+                    totalFrames += frames;
+                    totalDraws += draws;
+                });
+            }
+        }
+        for (long i = 0; lanes == 1 && i < instances; i++) {
+            const Chip& prototype = prototypes[i % prototypes.size()];
+            const Analysis& analysis = library[roms[i % roms.size()]].analysis;
+            uint32_t instanceSeed = seed + (uint32_t)i;
+            pool.submit([&prototype, &analysis, instanceSeed, instructions,
+                         instructionsPerFrame, &totalInstructions,
+                         &totalSkipped, &totalFrames, &totalDraws,
+                         &totalFaults, &totalWaiting] {
+                // a copy starts without translations of its own
+                Chip chip = prototype;
+                chip.pretranslate(analysis);
+                chip.seedRandom(instanceSeed);
+                long long executed = 0;
+                long long skipped = 0;
+                long long frames = 0;
+                long long draws = 0;
+                // emulated 60hz frames, as fast as the host allows
+                int budget = 0;
+                while (executed + skipped < instructions &&
+                       !chip.m_faulted) {
+                    budget += instructionsPerFrame;
+                    while (budget > 0) {
+                        RunResult result = chip.run(budget);
+                        budget -= result.instructions + result.skipped;
+                        executed += result.instructions;
+                        skipped += result.skipped;
+                        if (result.reason == StopReason::FrameDrawn) {
+                            draws++;
+                            chip.m_drawFlag = false;
+                        } else if (result.reason ==
+                                       StopReason::WaitingForKey ||
+                                   result.reason ==
+                                       StopReason::IllegalOpcode) {
+                            // waiting for a key that never comes, or halted
+                            budget = 0;
+                        }
+                    }
+                    chip.tickTimers();
+                    frames++;
+                    // nobody presses keys here, once the timers have run out
+                    // a machine waiting for one will never change again
+                    if (!chip.keyWaitOver() && chip.m_delayTimer == 0 &&
+                        chip.m_soundTimer == 0) {
+                        totalWaiting++;
+                        break;
+                    }
+                }
+                // a faulting instance stops early, the others carry on
+                if (chip.m_faulted)
+                    totalFaults++;
+                totalInstructions += executed;
+                totalSkipped += skipped;
+                totalFrames += frames;
+                totalDraws += draws;
+            });
+        }
+        pool.wait();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << "ROMs:         " << roms.size() << "\n";
+    std::cout << "Instances:    " << instances << "\n";
+    std::cout << "Threads:      " << threads << "\n";
+    std::cout << "Lanes:        " << lanes << "\n";
+    std::cout << "Seed:         " << seed << "\n";
+    std::cout << "Elapsed:      " << seconds << " s\n";
+    std::cout << "Instructions: " << totalInstructions << " ("
+              << totalInstructions / seconds << " /s)\n";
+    std::cout << "Skipped:      " << totalSkipped << "\n";
+    std::cout << "Frames:       " << totalFrames << " ("
+              << totalFrames / seconds << " /s)\n";
+    std::cout << "Draws:        " << totalDraws << " ("
+              << totalDraws / seconds << " /s)\n";
+    std::cout << "Faults:       " << totalFaults << "\n";
+    std::cout << "Waiting:      " << totalWaiting << "\n";
+
+    return 0;
+}
@@ -0,0 +1,40 @@
+#include "../includes/beeper.hpp"
+
+const unsigned int sampleRate = 44100;
+// around 6ms per buffer
+const size_t bufferSamples = 256;
+
+Beeper::Beeper(float frequency, sf::Int16 amplitude)
+    : m_active(false), m_halfPeriod(sampleRate / frequency / 2.0f),
+      m_phase(0.0f), m_amplitude(amplitude), m_samples(bufferSamples) {
+    initialize(1, sampleRate);
+}
+
+Beeper::~Beeper() { stop(); }
+
+void Beeper::setActive(bool active) {
+    if (active == m_active)
+        return;
+    m_active = active;
+    if (active)
+        play();
+    else
+        stop();
+}
+
+bool Beeper::onGetData(Chunk& data) {
+    for (sf::Int16& sample : m_samples) {
+        // the sign flips every half period
+        sample = m_phase < m_halfPeriod ? m_amplitude : -m_amplitude;
+        m_phase += 1.0f;
+        if (m_phase >= 2.0f * m_halfPeriod)
+            m_phase -= 2.0f * m_halfPeriod;
+    }
+    data.samples = m_samples.data();
+    data.sampleCount = m_samples.size();
+    return true;
+}
+
+// play() always starts from the beginning, so every tone starts on the same
+// edge of the wave
+void Beeper::onSeek(sf::Time timeOffset) { m_phase = 0.0f; }
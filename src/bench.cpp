@@ -0,0 +1,266 @@
+#include <algorithm>
+#include <chrono>
+
+#include "../includes/chip.hpp"
+#include "../includes/lockstep.hpp"
+#include "../includes/romlibrary.hpp"
+
+// headless benchmark suite
+// runs every ROM and a few synthetic programs on every engine for a fixed
+// number of instructions, with the same scripted input each time, and
+// prints the results as JSON so runs can be compared by a script
+// rates are over the instructions that were executed, idle loops counted
+// off by Chip::run() only show up as skipped
+// with lanes= every program also runs that many machines in lockstep, with
+// rates over the instructions of all lanes together
+
+struct Program {
+    std::string name;
+    std::string kind;
+    std::vector<Byte> image;
+};
+
+struct Result {
+    long long instructions;
+    long long skipped;
+    long long frames;
+    long long draws;
+    double seconds;
+    bool faulted;
+};
+
+// assembles opcodes into a ROM image
+static std::vector<Byte> assemble(std::initializer_list<Opcode> opcodes) {
+    std::vector<Byte> image;
+    for (Opcode opcode : opcodes) {
+        image.push_back(opcode >> 8);
+        image.push_back(opcode & 0xFF);
+    }
+    return image;
+}
+
+// register arithmetic, index updates, a skip and a call per iteration, the
+// mix most games spend their time in outside of drawing
+static Program opcodeMix() {
+    return {"opcode-mix", "synthetic",
+            assemble({
+                0x6000, // 200: V0 = 0
+                0x6101, // 202: V1 = 1
+                0x6203, // 204: V2 = 3
+                0x7001, // 206: V0 += 1
+                0x8014, // 208: V0 += V1
+                0x8125, // 20A: V1 -= V2
+                0x8203, // 20C: V2 ^= V0
+                0x8306, // 20E: V3 >>= 1
+                0xA300, // 210: I = 300
+                0xF01E, // 212: I += V0
+                0x221A, // 214: call 21A
+                0x1206, // 216: jump 206
+                0x0000, // 218: unused
+                0x8401, // 21A: V4 |= V0
+                0x3000, // 21C: skip if V0 == 0
+                0x00EE, // 21E: return
+                0x00EE, // 220: return
+            })};
+}
+
+// two sprites drawn per iteration at moving positions, so rows wrap and
+// collide
+static Program spriteDraws() {
+    return {"dxyn", "synthetic",
+            assemble({
+                0x6000, // 200: V0 = 0
+                0x6100, // 202: V1 = 0
+                0x6200, // 204: V2 = 0
+                0xF229, // 206: I = font(V2)
+                0xD015, // 208: draw V0, V1
+                0xD105, // 20A: draw V1, V0
+                0x7003, // 20C: V0 += 3
+                0x7102, // 20E: V1 += 2
+                0x7201, // 210: V2 += 1
+                0x4210, // 212: skip if V2 != 16
+                0x6200, // 214: V2 = 0
+                0x1206, // 216: jump 206
+            })};
+}
+
+// a key is held for a few frames, then nothing for a few, cycling through
+// all 16 keys in an order that is the same every run
+static unsigned short scriptedKeys(long long frame) {
+    long long step = frame / 8;
+    if (step % 2)
+        return 0;
+    return 1 << ((step * 7) % 16);
+}
+
+static Result run(const Program& program, Engine engine,
+                  long long instructions, int instructionsPerFrame,
+                  bool fastForward) {
+    // the same seed every run, so runs only differ in how fast they are
+    Chip chip;
+    chip.seedRandom(1);
+    chip.setEngine(engine);
+    chip.m_fastForward = fastForward;
+    if (!chip.loadROM(program.image.data(), program.image.size()))
+        exit(ROM_LOAD_ERR);
+
+    Result result = {0, 0, 0, 0, 0.0, false};
+    int budget = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (result.instructions + result.skipped < instructions &&
+           !chip.m_faulted) {
+        chip.m_keys = scriptedKeys(result.frames);
+        budget += instructionsPerFrame;
+        while (budget > 0) {
+            RunResult run = chip.run(budget);
+            budget -= run.instructions + run.skipped;
+            result.instructions += run.instructions;
+            result.skipped += run.skipped;
+            if (run.reason == StopReason::FrameDrawn) {
+                result.draws++;
+                chip.m_drawFlag = false;
+            } else if (run.reason == StopReason::WaitingForKey ||
+                       run.reason == StopReason::IllegalOpcode) {
+                budget = 0;
+            }
+        }
+        chip.tickTimers();
+        result.frames++;
+    }
+    result.faulted = chip.m_faulted;
+    auto end = std::chrono::steady_clock::now();
+    result.seconds = std::chrono::duration<double>(end - start).count();
+    return result;
+}
+
+// the same input for every lane, but each draws its own random numbers so
+// lanes can go different ways as they would in a batch
+static Result runLockstep(const Program& program, int lanes,
+                          long long instructions, int instructionsPerFrame) {
+    Chip prototype;
+    if (!prototype.loadROM(program.image.data(), program.image.size()))
+        exit(ROM_LOAD_ERR);
+    Lockstep lockstep(prototype, lanes);
+    for (int lane = 0; lane < lanes; lane++)
+        lockstep.machine(lane).seedRandom(1 + lane);
+
+    Result result = {0, 0, 0, 0, 0.0, false};
+    auto start = std::chrono::steady_clock::now();
+    while (result.instructions < instructions * lanes && !result.faulted) {
+        for (int lane = 0; lane < lanes; lane++)
+            lockstep.machine(lane).m_keys = scriptedKeys(result.frames);
+        result.instructions += lockstep.run(instructionsPerFrame);
+        result.faulted = true;
+        for (int lane = 0; lane < lanes; lane++) {
+            Chip& chip = lockstep.machine(lane);
+            if (chip.m_drawFlag) {
+                result.draws++;
+                chip.m_drawFlag = false;
+            }
+            result.faulted &= chip.m_faulted;
+        }
+        lockstep.tickTimers();
+        result.frames++;
+    }
+    auto end = std::chrono::steady_clock::now();
+    result.seconds = std::chrono::duration<double>(end - start).count();
+    return result;
+}
+
+// ROM names are file names, the only characters that need escaping
+static std::string jsonString(const std::string& text) {
+    std::string escaped = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        escaped += c;
+    }
+    return escaped + "\"";
+}
+
+static void print(const Program& program, const std::string& engineName,
+                  int lanes, const Result& result, bool& first) {
+    // a ROM that only idled executed next to nothing
+    long long executed = std::max(1LL, result.instructions);
+    std::cout << (first ? "\n" : ",\n");
+    first = false;
+    std::cout << "    {\"name\": " << jsonString(program.name)
+              << ", \"kind\": \"" << program.kind << "\", \"engine\": \""
+              << engineName << "\", \"lanes\": " << lanes
+              << ", \"instructions\": " << result.instructions
+              << ", \"skipped\": " << result.skipped
+              << ", \"frames\": " << result.frames
+              << ", \"draws\": " << result.draws << ", \"faulted\": "
+              << (result.faulted ? "true" : "false")
+              << ", \"seconds\": " << result.seconds
+              << ", \"instructionsPerSecond\": "
+              << executed / result.seconds << ", \"nsPerInstruction\": "
+              << result.seconds * 1e9 / executed
+              << ", \"framesPerSecond\": " << result.frames / result.seconds
+              << "}";
+}
+
+int main(int argc, char* argv[]) {
+    long long instructions = 2000000;
+    int instructionsPerFrame = Chip::defaultInstructionsPerFrame;
+    bool fastForward = true;
+    int lanes = 0;
+    std::vector<std::string> engineNames = {"switch", "predecoded", "jit"};
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        Engine engine;
+        if (arg.rfind("instructions=", 0) == 0) {
+            instructions =
+                std::max(1LL, std::atoll(arg.substr(13).c_str()));
+        } else if (arg.rfind("ipf=", 0) == 0) {
+            instructionsPerFrame =
+                std::max(1, std::atoi(arg.substr(4).c_str()));
+        } else if (arg.rfind("lanes=", 0) == 0) {
+            lanes = std::max(1, std::atoi(arg.substr(6).c_str()));
+        } else if (arg == "fastforward=off") {
+            fastForward = false;
+        } else if (arg.rfind("engine=", 0) == 0 &&
+                   Chip::engineFromName(arg.substr(7), engine)) {
+            engineNames = {arg.substr(7)};
+        } else {
+            std::cerr << "Usage: ./benchmark [?instructions=count] "
+                         "[?engine=switch|predecoded|jit] [?ipf=count] "
+                         "[?fastforward=off] [?lanes=count]\n";
+            exit(ROM_LOAD_ERR);
+        }
+    }
+
+    std::vector<Program> programs = {opcodeMix(), spriteDraws()};
+    RomLibrary library;
+    if (!library.scan("./roms/"))
+        exit(ROM_LOAD_ERR);
+    for (size_t i = 0; i < library.size(); i++)
+        if (library[i].fits)
+            programs.push_back({library[i].name, "rom", library[i].image});
+
+    std::cout << "{\n";
+    std::cout << "  \"instructions\": " << instructions << ",\n";
+    std::cout << "  \"instructionsPerFrame\": " << instructionsPerFrame
+              << ",\n";
+    std::cout << "  \"fastForward\": " << (fastForward ? "true" : "false")
+              << ",\n";
+    std::cout << "  \"results\": [";
+    bool first = true;
+    for (const std::string& engineName : engineNames) {
+        Engine engine;
+        Chip::engineFromName(engineName, engine);
+        for (const Program& program : programs) {
+            Result result = run(program, engine, instructions,
+                                instructionsPerFrame, fastForward);
+            print(program, engineName, 1, result, first);
+        }
+    }
+    for (size_t i = 0; lanes > 0 && i < programs.size(); i++) {
+        Result result = runLockstep(programs[i], lanes, instructions,
+                                    instructionsPerFrame);
+        print(programs[i], "lockstep", lanes, result, first);
+    }
+    std::cout << "\n  ]\n}\n";
+
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "../includes/capture.hpp"
+
+// turns capture files into Y4M video, which most players and encoders read
+// frames are scaled up here, with square pixels, rather than when they are
+// recorded
+
+struct Color {
+    uint8_t y;
+    uint8_t cb;
+    uint8_t cr;
+};
+
+// from red, green and blue between 0 and 1, to BT.601 studio range, as
+// Y4M players expect
+static Color toYCbCr(double r, double g, double b) {
+    Color color;
+    color.y = (uint8_t)(16 + (65.481 * r + 128.553 * g + 24.966 * b));
+    color.cb = (uint8_t)(128 + (-37.797 * r - 74.203 * g + 112.0 * b));
+    color.cr = (uint8_t)(128 + (112.0 * r - 93.786 * g - 18.214 * b));
+    return color;
+}
+
+static bool readHeader(std::FILE* file) {
+    CaptureHeader header;
+    return std::fread(&header, sizeof(header), 1, file) == 1 &&
+           std::memcmp(header.magic, "C8CP", 4) == 0 &&
+           header.version == CAPTURE_VERSION &&
+           header.frameRate == Capture::frameRate;
+}
+
+// reads the next frame, applying it to the last one
+static bool readFrame(std::FILE* file, CaptureRecord& record, Frame& frame) {
+    uint8_t packed[Capture::maxPacked];
+    uint8_t data[Capture::frameBytes];
+    if (std::fread(&record, sizeof(record), 1, file) != 1 ||
+        record.length > sizeof(packed) ||
+        std::fread(packed, 1, record.length, file) != record.length ||
+        !Capture::unpack(packed, record.length, data, sizeof(data)))
+        return false;
+    uint8_t* words = (uint8_t*)frame.words;
+    for (size_t i = 0; i < sizeof(data); i++)
+        words[i] = record.key ? data[i] : words[i] ^ data[i];
+    frame.hires = record.hires;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> paths;
+    int scale = 10;
+    Color on = toYCbCr(1, 1, 1);
+    Color off = toYCbCr(0, 0, 0);
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg.rfind("scale=", 0) == 0)
+            scale = std::max(1, std::atoi(arg.substr(6).c_str()));
+        else if (arg == "alt")
+            on = toYCbCr(0, 1, 0);
+        else
+            paths.push_back(arg);
+    }
+    if (paths.size() != 2) {
+        std::cerr << "Usage: ./capexport [capture file] [video file] "
+                     "[?scale=factor] [?alt]\n";
+        exit(CAPTURE_LOAD_ERR);
+    }
+
+    std::FILE* file = std::fopen(paths[0].c_str(), "rb");
+    if (!file || !readHeader(file)) {
+        std::cerr << "Not a capture file, or from another version\n";
+        exit(CAPTURE_LOAD_ERR);
+    }
+
+    // a video keeps one size throughout, 128x64 if any frame needs it, with
+    // 64x32 frames doubled up
+    CaptureRecord record;
+    Frame frame = {};
+    bool hires = false;
+    while (readFrame(file, record, frame))
+        hires = hires || frame.hires;
+    int width = (hires ? 128 : 64) * scale;
+    int height = (hires ? 64 : 32) * scale;
+
+    std::FILE* video = std::fopen(paths[1].c_str(), "wb");
+    if (!video) {
+        std::cerr << "Failed to open " << paths[1] << "\n";
+        exit(CAPTURE_LOAD_ERR);
+    }
+    std::fprintf(video, "YUV4MPEG2 W%d H%d F%u:1 Ip A1:1 C444\n", width,
+                 height, Capture::frameRate);
+
+    std::fseek(file, sizeof(CaptureHeader), SEEK_SET);
+    std::vector<uint8_t> planes((size_t)width * height * 3);
+    uint64_t frames = 0;
+    uint64_t repeated = 0;
+    bool first = true;
+    while (readFrame(file, record, frame)) {
+        // frames missing from the file showed the same display as the last
+        uint64_t copies = first ? 1 : record.frame - frames + 1;
+        if (!first)
+            repeated += copies - 1;
+        for (uint64_t copy = 1; copy < copies; copy++) {
+            std::fputs("FRAME\n", video);
+            std::fwrite(planes.data(), 1, planes.size(), video);
+        }
+
+        int frameWidth = frame.hires ? 128 : 64;
+        // video pixels per display pixel
+        int pixelSize = width / frameWidth;
+        uint8_t* y = planes.data();
+        uint8_t* cb = y + (size_t)width * height;
+        uint8_t* cr = cb + (size_t)width * height;
+        for (int row = 0; row < height; row++) {
+            for (int column = 0; column < width; column++) {
+                int pixel =
+                    row / pixelSize * frameWidth + column / pixelSize;
+                uint64_t word = frame.words[pixel / 64];
+                const Color& color = (word >> (63 - pixel % 64)) & 1 ? on
+                                                                     : off;
+                size_t at = (size_t)row * width + column;
+                y[at] = color.y;
+                cb[at] = color.cb;
+                cr[at] = color.cr;
+            }
+        }
+        std::fputs("FRAME\n", video);
+        std::fwrite(planes.data(), 1, planes.size(), video);
+        frames = record.frame + 1;
+        first = false;
+    }
+    std::fclose(video);
+    std::fclose(file);
+
+    std::cerr << frames << " frames written, " << repeated
+              << " of them repeats of the one before\n";
+    return 0;
+}
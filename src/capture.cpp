@@ -0,0 +1,147 @@
+#include <chrono>
+
+#include "../includes/capture.hpp"
+
+Capture::Capture(size_t capacity)
+    : m_frame(0), m_head(0), m_tail(0), m_dropped(0), m_running(false),
+      m_file(nullptr), m_lastKey(0), m_written(false) {
+    size_t size = 1;
+    while (size < capacity)
+        size *= 2;
+    m_ring.resize(size);
+}
+
+Capture::~Capture() { stop(); }
+
+bool Capture::start(const std::string& path) {
+    stop();
+    m_file = std::fopen(path.c_str(), "wb");
+    if (!m_file)
+        return false;
+
+    CaptureHeader header;
+    std::memcpy(header.magic, "C8CP", 4);
+    header.version = CAPTURE_VERSION;
+    header.frameRate = frameRate;
+    std::fwrite(&header, sizeof(header), 1, m_file);
+
+    m_frame = 0;
+    m_head.store(0);
+    m_tail.store(0);
+    m_dropped.store(0);
+    m_written = false;
+    m_running.store(true);
+    m_writer = std::thread(&Capture::drain, this);
+    return true;
+}
+
+void Capture::stop() {
+    if (!m_file)
+        return;
+    m_running.store(false);
+    m_writer.join();
+    std::fclose(m_file);
+    m_file = nullptr;
+}
+
+void Capture::drain() {
+    while (true) {
+        // read before looking at the ring, so nothing recorded before
+        // stop() is left behind
+        bool running = m_running.load();
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t head = m_head.load(std::memory_order_acquire);
+        if (head == tail) {
+            if (!running)
+                break;
+            // frames come every 16ms
+            std::this_thread::sleep_for(std::chrono::milliseconds(4));
+            continue;
+        }
+
+        for (; tail != head; tail++) {
+            write(m_ring[tail & (m_ring.size() - 1)]);
+            m_tail.store(tail + 1, std::memory_order_release);
+        }
+    }
+    std::fflush(m_file);
+}
+
+// key frames start the file, every change of resolution and come back at
+// keyInterval, so an export never has to go far back to find one
+void Capture::write(const Slot& slot) {
+    const Frame& frame = slot.frame;
+    bool key = !m_written || frame.hires != m_previous.hires ||
+               slot.number - m_lastKey >= keyInterval;
+    uint8_t data[frameBytes];
+    std::memcpy(data, frame.words, frameBytes);
+    if (!key) {
+        const uint8_t* previous = (const uint8_t*)m_previous.words;
+        for (size_t i = 0; i < frameBytes; i++)
+            data[i] ^= previous[i];
+    } else {
+        m_lastKey = slot.number;
+    }
+
+    uint8_t packed[maxPacked];
+    CaptureRecord record;
+    record.frame = slot.number;
+    record.length = (uint16_t)pack(data, frameBytes, packed);
+    record.hires = frame.hires;
+    record.key = key;
+    std::fwrite(&record, sizeof(record), 1, m_file);
+    std::fwrite(packed, 1, record.length, m_file);
+    m_previous = frame;
+    m_written = true;
+}
+
+// runs shorter than three bytes are left in with the bytes to copy, so
+// packing never adds more than a control byte for every 128 bytes
+size_t Capture::pack(const uint8_t* data, size_t size, uint8_t* packed) {
+    size_t length = 0;
+    size_t i = 0;
+    while (i < size) {
+        size_t run = 1;
+        while (i + run < size && run < 129 && data[i + run] == data[i])
+            run++;
+        if (run >= 3) {
+            packed[length++] = (uint8_t)(run + 0x7E);
+            packed[length++] = data[i];
+            i += run;
+            continue;
+        }
+        size_t start = i;
+        while (i < size && i - start < 128 &&
+               !(i + 2 < size && data[i + 1] == data[i] &&
+                 data[i + 2] == data[i]))
+            i++;
+        packed[length++] = (uint8_t)(i - start - 1);
+        std::memcpy(packed + length, data + start, i - start);
+        length += i - start;
+    }
+    return length;
+}
+
+bool Capture::unpack(const uint8_t* packed, size_t length, uint8_t* data,
+                     size_t size) {
+    size_t out = 0;
+    size_t i = 0;
+    while (i < length) {
+        uint8_t control = packed[i++];
+        if (control < 0x80) {
+            size_t count = control + 1;
+            if (i + count > length || out + count > size)
+                return false;
+            std::memcpy(data + out, packed + i, count);
+            i += count;
+            out += count;
+        } else {
+            size_t count = control - 0x7E;
+            if (i >= length || out + count > size)
+                return false;
+            std::memset(data + out, packed[i++], count);
+            out += count;
+        }
+    }
+    return out == size;
+}
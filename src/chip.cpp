@@ -1,69 +1,51 @@
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <type_traits>
+
+#include "../includes/analysis.hpp"
 #include "../includes/chip.hpp"
 
 // initialize or reset the CHIP-8 system
 Chip::Chip() {
-    m_memory.clear();
-    m_memory.resize(4096);
+    // zeroes memory, registers, stack, keys, display and timers
+    // padding included, so identical machines have identical bytes
+    std::memset(static_cast<ChipState*>(this), 0, sizeof(ChipState));
 
     loadFont();
 
     // setting up rng for opcode 0xCXNN
-    srand(time(NULL));
+    seedRandom(std::random_device()());
 
     m_programCounter = 0x0200; // 512 bytes
-    m_indexRegister = 0;
-
-    m_registers.clear();
-    m_registers.resize(16);
-
-    m_stack.clear();
-    m_stack.resize(16);
-
-    m_stackPointer = 0;
-
-    m_keys.clear();
-    m_keys.resize(16);
-
-    m_frameBuffer.clear();
-    m_frameBuffer.resize(64 * 32);
-
-    m_delayTimer = 0;
-    m_soundTimer = 0;
 
-    m_drawFlag = false;
+    m_engine = Engine::Switch;
+    setQuirks(Quirks::Modern);
+    m_stores = 0;
+    m_fastForward = true;
+    m_tracer = nullptr;
 }
 
 // same as the constructor, but for reseting
 void Chip::reset() {
-    m_memory.clear();
-    m_memory.resize(4096);
+    uint32_t seed = m_randomSeed;
+    Byte flags[sizeof(m_flags)];
+    std::memcpy(flags, m_flags, sizeof(m_flags));
+    std::memset(static_cast<ChipState*>(this), 0, sizeof(ChipState));
+    std::memcpy(m_flags, flags, sizeof(m_flags));
 
     loadFont();
 
     // setting up rng for opcode 0xCXNN
-    srand(time(NULL));
+    seedRandom(seed);
 
     m_programCounter = 0x0200; // 512 bytes
-    m_indexRegister = 0;
 
-    m_registers.clear();
-    m_registers.resize(16);
-
-    m_stack.clear();
-    m_stack.resize(16);
-
-    m_stackPointer = 0;
-
-    m_keys.clear();
-    m_keys.resize(16);
-
-    m_frameBuffer.clear();
-    m_frameBuffer.resize(64 * 32);
-
-    m_delayTimer = 0;
-    m_soundTimer = 0;
-
-    m_drawFlag = false;
+    // the selected engine survives a reset, its decoded code does not
+    if (!m_decoded.empty())
+        invalidateDecoded();
+    m_jit.flush();
 }
 
 // dumps contents of memory to stdout
@@ -86,33 +68,56 @@ void Chip::debug_instructions(Opcode opcode) {
     std::cout << "SP: " << std::hex << m_stackPointer << std::dec << "\n\n";
 }
 
+// font taken from
+// http://www.multigesture.net/articles/how-to-write-an-emulator-chip-8-interpreter/
+// both fonts are compiled into the binary, and loading them is a copy
+static constexpr Byte chip8_fontset[80] = {
+    0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+    0x20, 0x60, 0x20, 0x20, 0x70, // 1
+    0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+    0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+    0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+    0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+    0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+    0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+    0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+    0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+    0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+    0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+    0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+    0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+    0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+    0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+};
+
+// SUPER-CHIP 8x10 digits for FX30, straight after the small ones
+// 0 - 9 as on the HP48, A - F as most later interpreters have them
+static constexpr Byte schip_fontset[160] = {
+    0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+    0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+    0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+    0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+    0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+    0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+    0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+};
+
 // load CHIP-8 fontset into memory
 // memory from 0 to 512 is basically empty, so we use the first 80 bytes to
 // store this
 void Chip::loadFont() {
-    // font taken from
-    // http://www.multigesture.net/articles/how-to-write-an-emulator-chip-8-interpreter/
-    Byte chip8_fontset[80] = {
-        0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-        0x20, 0x60, 0x20, 0x20, 0x70, // 1
-        0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-        0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-        0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-        0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-        0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-        0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-        0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-        0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-        0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-        0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-        0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-        0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-        0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-        0xF0, 0x80, 0xF0, 0x80, 0x80  // F
-    };
-    for (int i = 0x0000; i < 0x0050; i++) {
-        m_memory[i] = chip8_fontset[i];
-    }
+    std::memcpy(m_memory, chip8_fontset, sizeof(chip8_fontset));
+    std::memcpy(&m_memory[bigFontAddress], schip_fontset,
+                sizeof(schip_fontset));
 }
 
 // load a ROM into CHIP-8 memory
@@ -125,18 +130,556 @@ bool Chip::loadROM(std::string filepath) {
     if (rom.is_open()) {
         romSize = rom.tellg();
         rom.seekg(0, std::ios::beg);
-        // hacky conversion of vector<unsigned char> to char*
-        rom.read((char*)&m_memory[0x0200], romSize);
+        std::vector<Byte> image(romSize);
+        rom.read((char*)image.data(), romSize);
         rom.close();
-        return true;
+        return loadROM(image.data(), image.size());
     } else {
         std::cerr << "Failed to load ROM\n";
         return false;
     }
 }
 
+bool Chip::loadROM(const Byte* image, size_t size) {
+    if (size > maxROMSize) {
+        std::cerr << "ROM is too large to fit in memory\n";
+        return false;
+    }
+    std::memcpy(&m_memory[0x0200], image, size);
+    if (!m_decoded.empty())
+        invalidateDecoded();
+    m_jit.flush();
+    return true;
+}
+
+static_assert(std::is_trivially_copyable<ChipState>::value,
+              "save states rely on ChipState being copyable as raw bytes");
+
+void Chip::saveState(ChipState& state) const {
+    std::memcpy(&state, static_cast<const ChipState*>(this), sizeof(ChipState));
+}
+
+// memory may now hold different code, so nothing decoded or translated
+// survives
+void Chip::loadState(const ChipState& state) {
+    std::memcpy(static_cast<ChipState*>(this), &state, sizeof(ChipState));
+    if (!m_decoded.empty())
+        invalidateDecoded();
+    m_jit.flush();
+}
+
+size_t Chip::saveStateSize() {
+    return sizeof(SaveStateHeader) + sizeof(ChipState);
+}
+
+size_t Chip::saveState(Byte* buffer, size_t capacity) const {
+    if (capacity < saveStateSize())
+        return 0;
+    SaveStateHeader header = {{'C', '8', 'S', 'S'},
+                              SAVE_STATE_VERSION,
+                              (uint32_t)sizeof(ChipState)};
+    std::memcpy(buffer, &header, sizeof(header));
+    std::memcpy(buffer + sizeof(header), static_cast<const ChipState*>(this),
+                sizeof(ChipState));
+    return saveStateSize();
+}
+
+// states from another version or layout are refused rather than
+// reinterpreted
+bool Chip::loadState(const Byte* buffer, size_t size) {
+    if (size < saveStateSize()) {
+        std::cerr << "Save state is truncated\n";
+        return false;
+    }
+    SaveStateHeader header;
+    std::memcpy(&header, buffer, sizeof(header));
+    if (std::memcmp(header.magic, "C8SS", 4) != 0 ||
+        header.version != SAVE_STATE_VERSION ||
+        header.size != sizeof(ChipState)) {
+        std::cerr << "Incompatible save state\n";
+        return false;
+    }
+    ChipState state;
+    std::memcpy(&state, buffer + sizeof(header), sizeof(ChipState));
+    // no machine gets into these, and running from them would index past
+    // the stack or memory
+    if (state.m_stackPointer < 0 || state.m_stackPointer > stackDepth ||
+        state.m_programCounter > 0x0FFE ||
+        state.m_indexRegister > addressMask) {
+        std::cerr << "Corrupt save state\n";
+        return false;
+    }
+    loadState(state);
+    return true;
+}
+
+bool Chip::saveState(const std::string& filepath) const {
+    std::vector<Byte> buffer(saveStateSize());
+    saveState(&buffer[0], buffer.size());
+    std::ofstream file(filepath, std::ios::out | std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to write save state\n";
+        return false;
+    }
+    file.write((const char*)&buffer[0], buffer.size());
+    return file.good();
+}
+
+bool Chip::loadState(const std::string& filepath) {
+    std::ifstream file(filepath, std::ios::in | std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to load save state\n";
+        return false;
+    }
+    std::vector<Byte> buffer(saveStateSize());
+    file.read((char*)&buffer[0], buffer.size());
+    return loadState(&buffer[0], (size_t)file.gcount());
+}
+
+// clears every pixel of the display
+void Chip::clearScreen() {
+    std::fill(std::begin(m_frameBuffer), std::end(m_frameBuffer), 0);
+    m_drawFlag = true;
+    m_stores++;
+}
+
+// xor draws an 8 pixel wide sprite read from memory at I
+// in hires mode a height of 0 draws a 16x16 sprite instead, two bytes a row
+// VF is set when a set pixel gets flipped off
+// without clipping the display is addressed as one line of pixels, so a
+// sprite running off the right edge continues at the start of the next row,
+// and off the bottom continues at the top
+// with clipping only the position wraps, whatever then runs off an edge is
+// not drawn
+template <bool clip> void Chip::drawSprite(Byte x, Byte y, Byte height) {
+    int width = displayWidth();
+    int pixels = width * displayHeight();
+    int words = pixels / 64;
+    bool large = m_hires && height == 0;
+    int rows = large ? 16 : height;
+    if (clip) {
+        x %= width;
+        y %= displayHeight();
+        rows = std::min(rows, displayHeight() - y);
+    }
+
+    uint64_t collision = 0;
+    for (int i = 0; i < rows; i++) {
+        // the sprite row in the top bits of a word
+        uint64_t pattern;
+        if (large) {
+            int address = m_indexRegister + i * 2;
+            pattern = (uint64_t)((m_memory[address & addressMask] << 8) |
+                                 m_memory[(address + 1) & addressMask])
+                      << 48;
+        } else {
+            pattern = (uint64_t)m_memory[(m_indexRegister + i) & addressMask]
+                      << 56;
+        }
+        int start = (x + (y + i) * width) % pixels;
+        int word = start / 64;
+        int shift = start % 64;
+
+        uint64_t bits = pattern >> shift;
+        collision |= m_frameBuffer[word] & bits;
+        m_frameBuffer[word] ^= bits;
+
+        // the pixels that did not fit go on in the next word, unless that
+        // is the start of the next row and sprites are clipped
+        uint64_t rest = shift > 0 ? pattern << (64 - shift) : 0;
+        if (clip && (word + 1) % (width / 64) == 0)
+            rest = 0;
+        if (rest) {
+            int next = (word + 1) % words;
+            collision |= m_frameBuffer[next] & rest;
+            m_frameBuffer[next] ^= rest;
+        }
+    }
+    m_registers[0x000F] = collision != 0 ? 1 : 0;
+    m_drawFlag = true;
+    m_stores++;
+}
+
+template void Chip::drawSprite<false>(Byte x, Byte y, Byte height);
+template void Chip::drawSprite<true>(Byte x, Byte y, Byte height);
+
+// 00FE and 00FF, switching resolution starts from a clear display
+void Chip::setHires(bool hires) {
+    m_hires = hires;
+    clearScreen();
+}
+
+// 00CN, rows move down whole words at a time and blank rows come in at the
+// top
+void Chip::scrollDown(Byte rows) {
+    int wordsPerRow = m_hires ? 2 : 1;
+    int height = displayHeight();
+    std::memmove(&m_frameBuffer[rows * wordsPerRow], &m_frameBuffer[0],
+                 (height - rows) * wordsPerRow * sizeof(uint64_t));
+    std::fill(&m_frameBuffer[0], &m_frameBuffer[rows * wordsPerRow], 0);
+    m_drawFlag = true;
+    m_stores++;
+}
+
+// 00FB and 00FC scroll 4 pixels sideways, each row shifts as a whole, in
+// hires mode carrying across the middle of the row
+void Chip::scrollRight() {
+    if (m_hires) {
+        for (int row = 0; row < 64; row++) {
+            uint64_t& left = m_frameBuffer[row * 2];
+            uint64_t& right = m_frameBuffer[row * 2 + 1];
+            right = (right >> 4) | (left << 60);
+            left >>= 4;
+        }
+    } else {
+        for (int row = 0; row < 32; row++)
+            m_frameBuffer[row] >>= 4;
+    }
+    m_drawFlag = true;
+    m_stores++;
+}
+
+void Chip::scrollLeft() {
+    if (m_hires) {
+        for (int row = 0; row < 64; row++) {
+            uint64_t& left = m_frameBuffer[row * 2];
+            uint64_t& right = m_frameBuffer[row * 2 + 1];
+            left = (left << 4) | (right >> 60);
+            right <<= 4;
+        }
+    } else {
+        for (int row = 0; row < 32; row++)
+            m_frameBuffer[row] <<= 4;
+    }
+    m_drawFlag = true;
+    m_stores++;
+}
+
+// FX0A, the machine stays on this instruction until a key is pressed and
+// released again, the key goes into VX on its release as on the original
+// interpreter
+void Chip::waitForKey(Byte X) {
+    if (m_keyWait != KeyWait::Release) {
+        m_keyWait = KeyWait::Press;
+        // the highest key wins if several are down
+        for (int i = 0; i < 16; i++) {
+            if (isKeyDown(i)) {
+                m_waitKey = (Byte)i;
+                m_keyWait = KeyWait::Release;
+            }
+        }
+        return;
+    }
+    if (!isKeyDown(m_waitKey)) {
+        m_registers[X] = m_waitKey;
+        m_keyWait = KeyWait::None;
+        m_programCounter += 2;
+    }
+}
+
+// halts the machine, what happens next is up to the host
+void Chip::illegalOpcode(Opcode opcode) {
+    m_faulted = true;
+    m_faultOpcode = opcode;
+}
+
+// parses the name of an execution engine, as given on the command line
+bool Chip::engineFromName(const std::string& name, Engine& engine) {
+    if (name == "switch")
+        engine = Engine::Switch;
+    else if (name == "predecoded")
+        engine = Engine::Predecoded;
+    else if (name == "jit")
+        engine = Engine::Jit;
+    else
+        return false;
+    return true;
+}
+
+bool Chip::quirksFromName(const std::string& name, Quirks& quirks) {
+    if (name == "modern")
+        quirks = Quirks::Modern;
+    else if (name == "vip")
+        quirks = Quirks::CosmacVip;
+    else if (name == "chip48")
+        quirks = Quirks::Chip48;
+    else if (name == "schip")
+        quirks = Quirks::SuperChip;
+    else
+        return false;
+    return true;
+}
+
+// only reachable code counts, so sprite data that happens to look like a
+// SUPER-CHIP opcode is never looked at
+Quirks Chip::detectQuirks(const Analysis& analysis) {
+    for (unsigned short address : analysis.instructions()) {
+        Opcode opcode = analysis.opcode(address);
+        if (opcode == 0x00FB || opcode == 0x00FC || opcode == 0x00FD ||
+            opcode == 0x00FE || opcode == 0x00FF ||
+            (opcode & 0xFFF0) == 0x00C0 || (opcode & 0xF0FF) == 0xF030 ||
+            (opcode & 0xF0FF) == 0xF075 || (opcode & 0xF0FF) == 0xF085)
+            return Quirks::SuperChip;
+    }
+    return Quirks::Modern;
+}
+
+// every engine builds its code for one profile, so switching starts them
+// over
+void Chip::setQuirks(Quirks quirks) {
+    m_quirks = quirks;
+    switch (quirks) {
+    case Quirks::CosmacVip:
+        m_interpreter = &Chip::interpret<CosmacVipQuirks>;
+        break;
+    case Quirks::Chip48:
+        m_interpreter = &Chip::interpret<Chip48Quirks>;
+        break;
+    case Quirks::SuperChip:
+        m_interpreter = &Chip::interpret<SuperChipQuirks>;
+        break;
+    case Quirks::Modern:
+    default:
+        m_interpreter = &Chip::interpret<ModernQuirks>;
+        break;
+    }
+    if (!m_decoded.empty())
+        invalidateDecoded();
+    m_jit.flush();
+}
+
+// memory has to hold the image the analysis was made from
+void Chip::pretranslate(const Analysis& analysis) {
+    switch (m_engine) {
+    case Engine::Predecoded:
+        for (unsigned short address : analysis.instructions()) {
+            Opcode opcode =
+                (Opcode)((m_memory[address] << 8) | m_memory[address + 1]);
+            m_decoded[address] = decode(opcode, m_quirks);
+        }
+        break;
+    case Engine::Jit:
+        for (const Analysis::Block& block : analysis.blocks())
+            m_jit.prepare(*this, block.start, block.end);
+        break;
+    case Engine::Switch:
+        break;
+    }
+}
+
+// the engines share all machine state, but the predecoded one keeps a table
+// that is only built while it is in use
+void Chip::setEngine(Engine engine) {
+    m_engine = engine;
+    if (m_engine == Engine::Predecoded)
+        invalidateDecoded();
+    else
+        m_decoded.clear();
+    m_jit.flush();
+}
+
+void Chip::seedRandom(uint32_t seed) {
+    m_randomSeed = seed;
+    // spreads nearby seeds apart, and xorshift must never start from 0
+    uint32_t state = seed * 0x9E3779B9u;
+    state ^= state >> 16;
+    m_randomState = state ? state : 0x6D2B79F5u;
+}
+
+// counts both timers down, called by the host at 60hz regardless of how
+// many instructions run in between
+void Chip::tickTimers() {
+    if (m_delayTimer > 0)
+        m_delayTimer--;
+
+    if (m_soundTimer > 0) {
+        m_soundTimer--;
+    }
+}
+
+// executes with the selected engine and returns the number of instructions
+// that ran, which is always 1 except for translated blocks, where it is up
+// to maxInstructions
+int Chip::step(int maxInstructions) {
+    if (m_tracer)
+        return stepTraced();
+    PROFILE_BEGIN(*this);
+    int executed;
+    switch (m_engine) {
+    case Engine::Predecoded:
+        playPredecoded();
+        executed = 1;
+        break;
+    case Engine::Jit: {
+        unsigned short last;
+        executed = playJit(maxInstructions, last);
+    } break;
+    case Engine::Switch:
+    default:
+        play();
+        executed = 1;
+        break;
+    }
+    PROFILE_END(executed);
+    return executed;
+}
+
+// one instruction on the selected engine, translated blocks are left
+// alone so every instruction gets its own record
+int Chip::stepTraced() {
+    unsigned short pc = m_programCounter;
+    Opcode opcode = fetch(pc);
+    Byte before[16];
+    std::memcpy(before, m_registers, sizeof(before));
+
+    PROFILE_BEGIN(*this);
+    switch (m_engine) {
+    case Engine::Predecoded:
+        playPredecoded();
+        break;
+    case Engine::Jit:
+        playJitFallback();
+        break;
+    case Engine::Switch:
+    default:
+        play();
+        break;
+    }
+    PROFILE_END(1);
+
+    m_tracer->record(pc, opcode, m_indexRegister, before, m_registers);
+    return 1;
+}
+
+RunResult Chip::run(int maxInstructions) {
+    RunResult result = {StopReason::BudgetExhausted, 0, 0};
+    if (m_faulted) {
+        result.reason = StopReason::IllegalOpcode;
+        return result;
+    }
+
+    // draws and sound only count when they start during this call
+    // a halted machine does not even fetch until the keys change
+    if (!keyWaitOver()) {
+        result.reason = StopReason::WaitingForKey;
+        return result;
+    }
+
+    bool drawn = m_drawFlag;
+    bool sounding = m_soundTimer > 0;
+    // the host may change keys and timers between calls, a loop is only
+    // idle for as long as they stay the same
+    for (IdleMark& mark : m_idleMarks)
+        mark.valid = false;
+    // the budget used so far, executed and skipped
+    int used = 0;
+    while (used < maxInstructions) {
+        unsigned short pc = m_programCounter;
+        int executed;
+#ifndef CHIPPER_PROFILE
+        // the profiler and the tracer want every instruction on its own
+        if (m_engine == Engine::Predecoded && !m_tracer)
+            executed = playPredecoded(maxInstructions - used, pc);
+        else if (m_engine == Engine::Jit && !m_tracer)
+            executed = playJit(maxInstructions - used, pc);
+        else
+#endif
+            executed = step(maxInstructions - used);
+        result.instructions += executed;
+        used += executed;
+        if (m_faulted) {
+            result.reason = StopReason::IllegalOpcode;
+            break;
+        }
+        if (m_drawFlag && !drawn) {
+            result.reason = StopReason::FrameDrawn;
+            break;
+        }
+        if (m_soundTimer > 0 && !sounding) {
+            result.reason = StopReason::SoundStarted;
+            break;
+        }
+        if (m_keyWait != KeyWait::None) {
+            result.reason = StopReason::WaitingForKey;
+            break;
+        }
+
+        // only a backward jump can close a loop, and a traced machine
+        // records every pass
+        if (m_programCounter <= pc && !m_tracer && m_fastForward) {
+            int length = idleLoopLength(used);
+            if (length > 0) {
+                // the rest of the budget would only go round the same loop,
+                // count whole passes through it and run whatever is left
+                // over as usual
+                int passes = (maxInstructions - used) / length;
+                result.skipped += passes * length;
+                used += passes * length;
+                m_idleMarks[(m_programCounter >> 1) & 3].executed = used;
+            }
+        }
+    }
+    return result;
+}
+
+int Chip::idleLoopLength(int executed) {
+    IdleMark& mark = m_idleMarks[(m_programCounter >> 1) & 3];
+    bool same = mark.valid && mark.programCounter == m_programCounter &&
+                mark.indexRegister == m_indexRegister &&
+                mark.stores == m_stores && mark.keys == m_keys &&
+                mark.stackPointer == m_stackPointer &&
+                mark.delayTimer == m_delayTimer &&
+                mark.soundTimer == m_soundTimer &&
+                mark.keyWait == m_keyWait && mark.waitKey == m_waitKey &&
+                mark.randomState == m_randomState &&
+                std::memcmp(mark.registers, m_registers,
+                            sizeof(m_registers)) == 0 &&
+                std::memcmp(mark.stack, m_stack, sizeof(m_stack)) == 0;
+    if (same && executed > mark.executed)
+        return executed - mark.executed;
+
+    mark.programCounter = m_programCounter;
+    mark.indexRegister = m_indexRegister;
+    std::memcpy(mark.registers, m_registers, sizeof(m_registers));
+    std::memcpy(mark.stack, m_stack, sizeof(m_stack));
+    mark.stackPointer = m_stackPointer;
+    mark.keys = m_keys;
+    mark.delayTimer = m_delayTimer;
+    mark.soundTimer = m_soundTimer;
+    mark.keyWait = m_keyWait;
+    mark.waitKey = m_waitKey;
+    mark.randomState = m_randomState;
+    mark.stores = m_stores;
+    mark.executed = executed;
+    mark.valid = true;
+    return 0;
+}
+
+// runs translated blocks, or interprets one instruction the jit left out
+int Chip::playJit(int maxInstructions, unsigned short& pc) {
+    int executed = m_jit.execute(*this, maxInstructions, pc);
+    if (executed > 0)
+        return executed;
+
+    pc = m_programCounter;
+    playJitFallback();
+    return 1;
+}
+
+void Chip::playJitFallback() {
+    Opcode opcode = fetch(m_programCounter);
+    unsigned short index = m_indexRegister;
+    play();
+    // the same decoding as FX55 and FX33 in play(), these are the only
+    // instructions that write memory
+    if ((opcode & 0xF0FF) == 0xF055)
+        m_jit.invalidate(index, ((opcode & 0x0F00) >> 8) + 1);
+    else if ((opcode & 0xF00F) == 0xF003)
+        m_jit.invalidate(index, 3);
+}
+
 // fetch, decode, execute
-void Chip::play() {
+template <class Policy> void Chip::interpret() {
 
     // utility variables
     unsigned short randomNumber; // really only needs 1 byte, but unsigned short
@@ -148,9 +691,9 @@ void Chip::play() {
     unsigned short Y;
 
     // fetch
-    // get two bytes from memory according to the program counter
-    Opcode opcode = (Opcode)((m_memory[m_programCounter] << 8) |
-                             m_memory[m_programCounter + 1]);
+    // get two bytes from memory according to the program counter, past the
+    // end of memory this is 0000 and the machine halts on it
+    Opcode opcode = fetch(m_programCounter);
 
     // debug_instructions(opcode);
 
@@ -163,10 +706,7 @@ void Chip::play() {
             // 00E0
             // Clears the screen
 
-            for (int i = 0; i < 64 * 32; i++) {
-                m_frameBuffer[i] = false;
-            }
-            m_drawFlag = true;
+            clearScreen();
             m_programCounter += 2;
 
             break;
@@ -174,15 +714,65 @@ void Chip::play() {
             // 00EE
             // Returns from a subroutine
 
+            if (m_stackPointer <= 0) {
+                illegalOpcode(opcode);
+                break;
+            }
             m_stackPointer--;
             m_programCounter = m_stack[m_stackPointer];
             m_programCounter += 2;
 
+            break;
+        case 0x00FB:
+            // 00FB
+            // Scrolls the display right by 4 pixels (SUPER-CHIP)
+
+            scrollRight();
+            m_programCounter += 2;
+
+            break;
+        case 0x00FC:
+            // 00FC
+            // Scrolls the display left by 4 pixels (SUPER-CHIP)
+
+            scrollLeft();
+            m_programCounter += 2;
+
+            break;
+        case 0x00FD:
+            // 00FD
+            // Exits the interpreter (SUPER-CHIP). There is nothing to
+            // return to here, so the program counter stays put and the
+            // machine idles on this instruction until it is reset
+
+            break;
+        case 0x00FE:
+            // 00FE
+            // Switches to the 64x32 display (SUPER-CHIP)
+
+            setHires(false);
+            m_programCounter += 2;
+
+            break;
+        case 0x00FF:
+            // 00FF
+            // Switches to the 128x64 display (SUPER-CHIP)
+
+            setHires(true);
+            m_programCounter += 2;
+
             break;
         default:
-            std::cerr << "Illegal opcode encountered! " << std::hex
-                      << (int)opcode << std::dec << "\n";
-            exit(ILLEGAL_OPCODE_ERR);
+            if ((opcode & 0x00F0) == 0x00C0) {
+                // 00CN
+                // Scrolls the display down by N pixels (SUPER-CHIP)
+
+                N = opcode & 0x000F;
+                scrollDown((Byte)N);
+                m_programCounter += 2;
+            } else {
+                illegalOpcode(opcode);
+            }
             break;
         }
         break;
@@ -199,6 +789,10 @@ void Chip::play() {
         // Calls subroutine at NNN
 
         NNN = opcode & 0x0FFF;
+        if (m_stackPointer >= stackDepth) {
+            illegalOpcode(opcode);
+            break;
+        }
         m_stack[m_stackPointer] = m_programCounter;
         m_stackPointer++;
         m_programCounter = NNN;
@@ -282,7 +876,8 @@ void Chip::play() {
             X = (opcode & 0x0F00) >> 8;
             Y = (opcode & 0x00F0) >> 4;
             m_registers[X] = m_registers[X] | m_registers[Y];
-            m_registers[0x000F] = 0;
+            if (Policy::resetVF)
+                m_registers[0x000F] = 0;
             m_programCounter += 2;
 
             break;
@@ -293,7 +888,8 @@ void Chip::play() {
             X = (opcode & 0x0F00) >> 8;
             Y = (opcode & 0x00F0) >> 4;
             m_registers[X] = m_registers[X] & m_registers[Y];
-            m_registers[0x000F] = 0;
+            if (Policy::resetVF)
+                m_registers[0x000F] = 0;
             m_programCounter += 2;
 
             break;
@@ -304,7 +900,8 @@ void Chip::play() {
             X = (opcode & 0x0F00) >> 8;
             Y = (opcode & 0x00F0) >> 4;
             m_registers[X] = m_registers[X] ^ m_registers[Y];
-            m_registers[0x000F] = 0;
+            if (Policy::resetVF)
+                m_registers[0x000F] = 0;
             m_programCounter += 2;
 
             break;
@@ -343,11 +940,14 @@ void Chip::play() {
         case 0x0006:
             // 8XY6
             // Stores the least significant bit of VX in VF and then shifts
-            // VX to the right by 1
+            // VX to the right by 1 (VY is copied into VX first where the
+            // profile says so)
 
             X = (opcode & 0x0F00) >> 8;
             // Y is never used for some reason
             Y = (opcode & 0x00F0) >> 4;
+            if (Policy::shiftVY)
+                m_registers[X] = m_registers[Y];
             m_registers[0x000F] = m_registers[X] & 0x0001;
             m_registers[X] = (Byte)m_registers[X] >> 1;
             m_programCounter += 2;
@@ -372,20 +972,21 @@ void Chip::play() {
         case 0x000E:
             // 8XYE
             // Stores the most significant bit of VX in VF and then shifts VX
-            // to the left by 1
+            // to the left by 1 (VY is copied into VX first where the profile
+            // says so)
 
             X = (opcode & 0x0F00) >> 8;
             // Again, Y is not used
             Y = (opcode & 0x00F0) >> 4;
+            if (Policy::shiftVY)
+                m_registers[X] = m_registers[Y];
             m_registers[0x000F] = (m_registers[X] & 0x0080) >> 7;
             m_registers[X] = (Byte)(m_registers[X] << 1);
             m_programCounter += 2;
 
             break;
         default:
-            std::cerr << "Illegal opcode encountered! " << std::hex
-                      << (int)opcode << std::dec << "\n";
-            exit(ILLEGAL_OPCODE_ERR);
+            illegalOpcode(opcode);
             break;
         }
         break;
@@ -413,10 +1014,12 @@ void Chip::play() {
         break;
     case 0xB000:
         // BNNN
-        // Jumps to the address NNN plus V0
+        // Jumps to the address NNN plus V0 (plus VX, X being the top digit
+        // of NNN, where the profile says so)
 
         NNN = opcode & 0x0FFF;
-        m_programCounter = NNN + m_registers[0x0000];
+        X = Policy::jumpVX ? (opcode & 0x0F00) >> 8 : 0;
+        m_programCounter = NNN + m_registers[X];
 
         break;
     case 0xC000:
@@ -426,9 +1029,7 @@ void Chip::play() {
 
         X = (opcode & 0x0F00) >> 8;
         NN = opcode & 0x00FF;
-        // usually, rand() should be avoided
-        // might change to more "true" rng later
-        randomNumber = rand() % 256;
+        randomNumber = randomByte();
         m_registers[X] = randomNumber & NN;
         m_programCounter += 2;
 
@@ -440,42 +1041,14 @@ void Chip::play() {
         // bit-coded starting from memory location I; I value doesn’t change
         // after the execution of this instruction. As described above, VF
         // is set to 1 if any screen pixels are flipped from set to unset
-        // when the sprite is drawn, and to 0 if that doesn’t happen
+        // when the sprite is drawn, and to 0 if that doesn’t happen.
+        // In the 128x64 mode DXY0 draws a 16x16 sprite (SUPER-CHIP)
 
         X = (opcode & 0x0F00) >> 8;
         Y = (opcode & 0x00F0) >> 4;
         N = opcode & 0x000F;
-        Byte x = m_registers[X];
-        Byte y = m_registers[Y];
-        Byte height = N;
-        Byte width = 8;
-        Byte pixelRow;
-        // if no collisions, this will remain 0
-        m_registers[0x000F] = 0;
-        for (int i = 0; i < height; i++) {
-            pixelRow = m_memory[m_indexRegister + i];
-            for (int j = 0; j < width; j++) {
-                // get each pixel in pixelRow
-                // 128b10 = 10000000b2
-                // we right shift from 0 to 7 to get each bit
-                if ((pixelRow & (0x0080 >> j)) != 0) {
-                    // finding the x,y coordinate in the 1D framebuffer
-                    // row major
-                    int mapXYto1DArr = (x + j + ((y + i) * 64)) % 0x0800;
-                    if (m_frameBuffer[mapXYto1DArr]) {
-                        // xor mode drawing
-                        // if that pixel is 1, then collision occurs
-                        // (both pixels are 1)
-                        // and the pixel is xor'd to 0
-                        // we set VF to 1
-                        m_registers[0x000F] = 1;
-                    }
-                    m_frameBuffer[mapXYto1DArr] =
-                        (bool)(m_frameBuffer[mapXYto1DArr] ^ 1);
-                }
-            }
-        }
-        m_drawFlag = true;
+        drawSprite<Policy::clipSprites>(m_registers[X], m_registers[Y],
+                                        (Byte)N);
         m_programCounter += 2;
 
     }
@@ -490,7 +1063,7 @@ void Chip::play() {
             // a code block)
 
             X = (opcode & 0x0F00) >> 8;
-            if (m_keys[m_registers[X]])
+            if (isKeyDown(m_registers[X]))
                 m_programCounter += 4;
             else
                 m_programCounter += 2;
@@ -503,16 +1076,14 @@ void Chip::play() {
             // a code block)
 
             X = (opcode & 0x0F00) >> 8;
-            if (!m_keys[m_registers[X]])
+            if (!isKeyDown(m_registers[X]))
                 m_programCounter += 4;
             else
                 m_programCounter += 2;
 
             break;
         default:
-            std::cerr << "Illegal opcode encountered! " << std::hex
-                      << (int)opcode << std::dec << "\n";
-            exit(ILLEGAL_OPCODE_ERR);
+            illegalOpcode(opcode);
             break;
         }
         break;
@@ -527,24 +1098,15 @@ void Chip::play() {
             m_programCounter += 2;
 
             break;
-        case 0x000A: {
+        case 0x000A:
             // FX0A
             // A key press is awaited, and then stored in VX. (Blocking
             // Operation. All instruction halted until next key event)
 
             X = (opcode & 0x0F00) >> 8;
-            bool isKeyPressed = false;
-            for (int i = 0; i < 16; i++) {
-                if (m_keys[i]) {
-                    m_registers[X] = (Byte)i;
-                    isKeyPressed = true;
-                }
-            }
-            if (isKeyPressed)
-                m_programCounter += 2;
-        }
+            waitForKey(X);
 
-        break;
+            break;
         case 0x0005:
             switch (opcode & 0x00F0) {
             case 0x0010:
@@ -560,12 +1122,16 @@ void Chip::play() {
                 // FX55
                 // Stores V0 to VX (including VX) in memory starting at
                 // address I. The offset from I is increased by 1 for each
-                // value written, but I itself is left unmodified
+                // value written, I itself moves on only where the profile
+                // says so
 
                 X = (opcode & 0x0F00) >> 8;
                 for (int i = 0; i <= (int)X; i++) {
-                    m_memory[m_indexRegister + i] = m_registers[i];
+                    m_memory[(m_indexRegister + i) & addressMask] =
+                        m_registers[i];
                 }
+                advanceIndex<Policy>(X);
+                m_stores++;
                 m_programCounter += 2;
 
                 break;
@@ -573,22 +1139,59 @@ void Chip::play() {
                 // FX65
                 // Fills V0 to VX (including VX) with values from memory
                 // starting at address I. The offset from I is increased by
-                // 1 for each value written, but I itself is left unmodified
+                // 1 for each value written, I itself moves on only where the
+                // profile says so
 
                 X = (opcode & 0x0F00) >> 8;
                 for (int i = 0; i <= (int)X; i++) {
-                    m_registers[i] = m_memory[m_indexRegister + i];
+                    m_registers[i] =
+                        m_memory[(m_indexRegister + i) & addressMask];
+                }
+                advanceIndex<Policy>(X);
+                m_programCounter += 2;
+
+                break;
+            case 0x0070:
+                // FX75
+                // Stores V0 to VX in the RPL user flags, X < 8 (SUPER-CHIP)
+
+                X = (opcode & 0x0F00) >> 8;
+                for (int i = 0; i <= (int)X && i < 8; i++) {
+                    m_flags[i] = m_registers[i];
+                }
+                m_stores++;
+                m_programCounter += 2;
+
+                break;
+            case 0x0080:
+                // FX85
+                // Fills V0 to VX from the RPL user flags, X < 8 (SUPER-CHIP)
+
+                X = (opcode & 0x0F00) >> 8;
+                for (int i = 0; i <= (int)X && i < 8; i++) {
+                    m_registers[i] = m_flags[i];
                 }
                 m_programCounter += 2;
 
                 break;
             default:
-                std::cerr << "Illegal opcode encountered! " << std::hex
-                          << (int)opcode << std::dec << "\n";
-                exit(ILLEGAL_OPCODE_ERR);
+                illegalOpcode(opcode);
                 break;
             }
             break;
+        case 0x0000:
+            if ((opcode & 0x00F0) == 0x0030) {
+                // FX30
+                // Sets I to the location of the 8x10 sprite for the digit
+                // in VX (SUPER-CHIP)
+
+                X = (opcode & 0x0F00) >> 8;
+                m_indexRegister = bigFontAddress + (m_registers[X] & 0xF) * 10;
+                m_programCounter += 2;
+            } else {
+                illegalOpcode(opcode);
+            }
+            break;
         case 0x0008:
             // FX18
             // Sets the sound timer to VX
@@ -601,14 +1204,15 @@ void Chip::play() {
         case 0x000E:
             // FX1E
             // Adds VX to I. VF is set to 1 when there is a range overflow
-            // (I+VX>0xFFF), and to 0 when there isn't
+            // (I+VX>0xFFF), and to 0 when there isn't. I wraps around to
+            // stay within memory
 
             X = (opcode & 0x0F00) >> 8;
             m_registers[0x000F] = 0;
             if (m_indexRegister + m_registers[X] > 0x0FFF)
                 m_registers[0x000F] = 1;
             m_indexRegister =
-                (unsigned short)(m_indexRegister + m_registers[X]);
+                (m_indexRegister + m_registers[X]) & addressMask;
             m_programCounter += 2;
 
             break;
@@ -635,33 +1239,23 @@ void Chip::play() {
 
             X = (opcode & 0x0F00) >> 8;
             int VX = m_registers[X];
-            m_memory[m_indexRegister + 2] = VX % 10;
+            m_memory[(m_indexRegister + 2) & addressMask] = VX % 10;
             VX /= 10;
-            m_memory[m_indexRegister + 1] = VX % 10;
+            m_memory[(m_indexRegister + 1) & addressMask] = VX % 10;
             VX /= 10;
-            m_memory[m_indexRegister] = VX % 10;
+            m_memory[m_indexRegister & addressMask] = VX % 10;
+            m_stores++;
             m_programCounter += 2;
         }
 
         break;
         default:
-            std::cerr << "Illegal opcode encountered! " << std::hex
-                      << (int)opcode << std::dec << "\n";
-            exit(ILLEGAL_OPCODE_ERR);
+            illegalOpcode(opcode);
             break;
         }
         break;
     default:
-        std::cerr << "Illegal opcode encountered! " << std::hex << (int)opcode
-                  << std::dec << "\n";
-        exit(ILLEGAL_OPCODE_ERR);
+        illegalOpcode(opcode);
         break;
     }
-
-    if (m_delayTimer > 0)
-        m_delayTimer--;
-
-    if (m_soundTimer > 0) {
-        m_soundTimer--;
-    }
 }
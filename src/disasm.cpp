@@ -0,0 +1,274 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include "../includes/analysis.hpp"
+
+// static disassembler
+// lists the reachable code of a ROM block by block, with the sprite data
+// and unreached bytes around it, and exits with ILLEGAL_OPCODE_ERR if the
+// machine could reach an opcode that would stop it
+// instructions are read as the profile the ROM would run with, the one
+// detected unless quirks= picks another
+
+// Cowgod's mnemonics, with the SUPER-CHIP ones
+// BNNN jumps from V0 or from VX depending on the profile
+static std::string mnemonic(Opcode opcode, const QuirkSet& quirks) {
+    char text[32];
+    unsigned int X = (opcode & 0x0F00) >> 8;
+    unsigned int Y = (opcode & 0x00F0) >> 4;
+    unsigned int N = opcode & 0x000F;
+    unsigned int NN = opcode & 0x00FF;
+    unsigned int NNN = opcode & 0x0FFF;
+    if (!legal(opcode))
+        return "???";
+
+    switch (opcode & 0xF000) {
+    case 0x0000:
+        switch (opcode) {
+        case 0x00E0:
+            return "CLS";
+        case 0x00EE:
+            return "RET";
+        case 0x00FB:
+            return "SCR";
+        case 0x00FC:
+            return "SCL";
+        case 0x00FD:
+            return "EXIT";
+        case 0x00FE:
+            return "LOW";
+        case 0x00FF:
+            return "HIGH";
+        default:
+            std::snprintf(text, sizeof(text), "SCD %X", N);
+            break;
+        }
+        break;
+    case 0x1000:
+        std::snprintf(text, sizeof(text), "JP %03X", NNN);
+        break;
+    case 0x2000:
+        std::snprintf(text, sizeof(text), "CALL %03X", NNN);
+        break;
+    case 0x3000:
+        std::snprintf(text, sizeof(text), "SE V%X, %02X", X, NN);
+        break;
+    case 0x4000:
+        std::snprintf(text, sizeof(text), "SNE V%X, %02X", X, NN);
+        break;
+    case 0x5000:
+        std::snprintf(text, sizeof(text), "SE V%X, V%X", X, Y);
+        break;
+    case 0x6000:
+        std::snprintf(text, sizeof(text), "LD V%X, %02X", X, NN);
+        break;
+    case 0x7000:
+        std::snprintf(text, sizeof(text), "ADD V%X, %02X", X, NN);
+        break;
+    case 0x8000: {
+        static const char* names[16] = {"LD",   "OR",  "AND", "XOR",
+                                        "ADD",  "SUB", "SHR", "SUBN",
+                                        "",     "",    "",    "",
+                                        "",     "",    "SHL", ""};
+        std::snprintf(text, sizeof(text), "%s V%X, V%X", names[N], X, Y);
+        break;
+    }
+    case 0x9000:
+        std::snprintf(text, sizeof(text), "SNE V%X, V%X", X, Y);
+        break;
+    case 0xA000:
+        std::snprintf(text, sizeof(text), "LD I, %03X", NNN);
+        break;
+    case 0xB000:
+        std::snprintf(text, sizeof(text), "JP V%X, %03X",
+                      quirks.jumpVX ? X : 0, NNN);
+        break;
+    case 0xC000:
+        std::snprintf(text, sizeof(text), "RND V%X, %02X", X, NN);
+        break;
+    case 0xD000:
+        std::snprintf(text, sizeof(text), "DRW V%X, V%X, %X", X, Y, N);
+        break;
+    case 0xE000:
+        std::snprintf(text, sizeof(text), "%s V%X",
+                      NN == 0x9E ? "SKP" : "SKNP", X);
+        break;
+    default:
+        switch (NN) {
+        case 0x07:
+            std::snprintf(text, sizeof(text), "LD V%X, DT", X);
+            break;
+        case 0x0A:
+            std::snprintf(text, sizeof(text), "LD V%X, K", X);
+            break;
+        case 0x15:
+            std::snprintf(text, sizeof(text), "LD DT, V%X", X);
+            break;
+        case 0x18:
+            std::snprintf(text, sizeof(text), "LD ST, V%X", X);
+            break;
+        case 0x1E:
+            std::snprintf(text, sizeof(text), "ADD I, V%X", X);
+            break;
+        case 0x29:
+            std::snprintf(text, sizeof(text), "LD F, V%X", X);
+            break;
+        case 0x30:
+            std::snprintf(text, sizeof(text), "LD HF, V%X", X);
+            break;
+        case 0x33:
+            std::snprintf(text, sizeof(text), "LD B, V%X", X);
+            break;
+        case 0x55:
+            std::snprintf(text, sizeof(text), "LD [I], V%X", X);
+            break;
+        case 0x65:
+            std::snprintf(text, sizeof(text), "LD V%X, [I]", X);
+            break;
+        case 0x75:
+            std::snprintf(text, sizeof(text), "LD R, V%X", X);
+            break;
+        default:
+            std::snprintf(text, sizeof(text), "LD V%X, R", X);
+            break;
+        }
+        break;
+    }
+    return text;
+}
+
+// the start of every block, with where it goes on to
+static void printBlock(const Analysis::Block& block) {
+    std::printf("\n; %03X", block.start);
+    if (block.successors.empty())
+        std::printf(", ends here");
+    else
+        std::printf(" ->");
+    for (unsigned short successor : block.successors)
+        std::printf(" %03X", successor);
+    std::printf("\n");
+}
+
+static void printListing(const Analysis& analysis, const QuirkSet& quirks) {
+    const std::vector<Analysis::Block>& blocks = analysis.blocks();
+    size_t nextBlock = 0;
+    unsigned short end = (unsigned short)(0x200 + analysis.size());
+    unsigned short address = 0x200;
+    while (address < end) {
+        Byte use = analysis.use(address);
+        if (use & Analysis::instruction) {
+            if (nextBlock < blocks.size() &&
+                blocks[nextBlock].start == address)
+                printBlock(blocks[nextBlock++]);
+            Opcode opcode = analysis.opcode(address);
+            std::printf("%03X  %04X  %-16s", address, opcode,
+                        mnemonic(opcode, quirks).c_str());
+            if (!legal(opcode))
+                std::printf("; illegal opcode");
+            else if ((use | analysis.use(address + 1)) & Analysis::written)
+                std::printf("; written by the program");
+            std::printf("\n");
+            // an instruction can start in the middle of another
+            bool overlapped =
+                analysis.use(address + 1) & Analysis::instruction;
+            address += overlapped ? 1 : 2;
+        } else if (use & (Analysis::data | Analysis::written)) {
+            // one sprite row a line
+            Byte value = (Byte)(analysis.opcode(address) >> 8);
+            std::printf("%03X  %02X    ", address, value);
+            for (int bit = 7; bit >= 0; bit--)
+                std::printf("%c", (value >> bit) & 1 ? '#' : '.');
+            if (use & Analysis::written)
+                std::printf("      ; written by the program");
+            std::printf("\n");
+            address++;
+        } else {
+            // up to 8 unreached bytes a line
+            std::printf("%03X ", address);
+            int count = 0;
+            while (address < end && count < 8 &&
+                   !(analysis.use(address) &
+                     (Analysis::instruction | Analysis::data |
+                      Analysis::written))) {
+                std::printf(" %02X", analysis.opcode(address) >> 8);
+                address++;
+                count++;
+            }
+            std::printf("\n");
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string path;
+    bool quiet = false;
+    bool overridden = false;
+    Quirks quirks = Quirks::Modern;
+    bool valid = true;
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "quiet") {
+            quiet = true;
+        } else if (arg.rfind("quirks=", 0) == 0) {
+            overridden = true;
+            valid &= Chip::quirksFromName(arg.substr(7), quirks);
+        } else {
+            path = arg;
+        }
+    }
+    if (path.empty() || !valid) {
+        std::cerr << "Usage: ./disasm [ROM file] [?quiet] "
+                     "[?quirks=modern|vip|chip48|schip]\n";
+        exit(ROM_LOAD_ERR);
+    }
+
+    std::ifstream rom(path, std::ios::in | std::ios::binary | std::ios::ate);
+    if (!rom.is_open()) {
+        std::cerr << "Failed to load ROM\n";
+        exit(ROM_LOAD_ERR);
+    }
+    std::vector<Byte> image((size_t)rom.tellg());
+    rom.seekg(0, std::ios::beg);
+    rom.read((char*)image.data(), image.size());
+    if (image.size() > Chip::maxROMSize) {
+        std::cerr << "ROM is too large to fit in memory\n";
+        exit(ROM_LOAD_ERR);
+    }
+
+    Analysis analysis(image.data(), image.size());
+    if (!overridden)
+        quirks = Chip::detectQuirks(analysis);
+    if (!quiet)
+        printListing(analysis, quirkSet(quirks));
+
+    size_t data = 0;
+    size_t unknown = 0;
+    for (unsigned short address = 0x200; analysis.inside(address);
+         address++) {
+        Byte use = analysis.use(address);
+        if (!(use & Analysis::code) && (use & Analysis::data))
+            data++;
+        if (!use)
+            unknown++;
+    }
+    std::cerr << path << ": " << image.size() << " bytes, "
+              << analysis.instructions().size() << " instructions in "
+              << analysis.blocks().size() << " blocks, " << data
+              << " bytes of data, " << unknown << " bytes unknown\n";
+
+    // the things a static pass cannot vouch for, only the first stops a
+    // ROM for certain
+    for (unsigned short address : analysis.illegal())
+        std::fprintf(stderr, "%03X: illegal opcode %04X\n", address,
+                     analysis.opcode(address));
+    for (unsigned short address : analysis.escapes())
+        std::fprintf(stderr, "%03X: leaves the program\n", address);
+    for (unsigned short address : analysis.indirect())
+        std::fprintf(stderr, "%03X: BNNN, where it jumps is not followed\n",
+                     address);
+    if (analysis.selfModifying())
+        std::cerr << "the program can write over its own code\n";
+
+    return analysis.illegal().empty() ? 0 : ILLEGAL_OPCODE_ERR;
+}
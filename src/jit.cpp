@@ -0,0 +1,885 @@
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+
+#if defined(__x86_64__)
+#include <sys/mman.h>
+#endif
+
+#include "../includes/chip.hpp"
+
+// size of the executable buffer each machine translates into, when it fills
+// up everything is flushed and translated again
+const size_t codeBufferSize = 256 * 1024;
+// the most bytes any single instruction can be translated into, with the
+// budget check in front of it and where that returns, FX55 and FX65 of all
+// 16 registers being the longest
+const size_t maxInstructionBytes = 256;
+
+Jit::Jit() : m_code(nullptr), m_codeUsed(0), m_failed(false) {
+    m_context = {nullptr, 0, false, 0, 0};
+}
+
+Jit::~Jit() {
+#if defined(__x86_64__)
+    if (m_code)
+        munmap(m_code, codeBufferSize);
+#endif
+}
+
+Jit::Jit(const Jit&) : Jit() {}
+
+Jit& Jit::operator=(const Jit&) {
+    flush();
+    return *this;
+}
+
+bool Jit::available() {
+#if defined(__x86_64__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Jit::flush() {
+    if (m_codeUsed == 0)
+        return;
+    m_codeUsed = 0;
+    std::fill(m_blocks.begin(), m_blocks.end(), nullptr);
+    for (std::vector<Span>& spans : m_pages)
+        spans.clear();
+}
+
+// only the pages the range touches are looked at, and only translations
+// that read a byte of it are dropped, the code they were translated into
+// stays in the buffer until it is flushed
+void Jit::invalidate(unsigned short address, unsigned short length) {
+    // a write that wraps around the end of memory also wrote the start
+    int size = sizeof(ChipState::m_memory);
+    if (address + length > size) {
+        invalidate(0, address + length - size);
+        length = size - address;
+    }
+    int first = address;
+    int last = std::min(first + length, (int)sizeof(ChipState::m_memory));
+    if (m_codeUsed == 0 || first >= last)
+        return;
+    for (int page = first / pageSize; page <= (last - 1) / pageSize;
+         page++) {
+        std::vector<Span>& spans = m_pages[page];
+        for (size_t i = 0; i < spans.size();) {
+            if (spans[i].start < last && spans[i].end > first) {
+                m_blocks[spans[i].start] = nullptr;
+                spans[i] = spans.back();
+                spans.pop_back();
+            } else {
+                i++;
+            }
+        }
+    }
+}
+
+bool Jit::ready() {
+    if (m_blocks.empty()) {
+        if (!available() || m_failed)
+            return false;
+        m_blocks.assign(sizeof(ChipState::m_memory), nullptr);
+        m_pages.assign(sizeof(ChipState::m_memory) / pageSize, {});
+    }
+    return true;
+}
+
+int Jit::execute(Chip& chip, int maxInstructions, unsigned short& last) {
+    unsigned short pc = chip.m_programCounter;
+    if (pc > 0x0FFE || !ready())
+        return 0;
+
+    JitBlock block = m_blocks[pc];
+    if (!block) {
+        int count;
+        block = translate(chip, pc, count);
+        if (!block)
+            return 0;
+        m_blocks[pc] = block;
+    }
+
+    m_context.blocks = m_blocks.data();
+    m_context.budget = maxInstructions;
+    m_context.backwards = !chip.m_fastForward;
+    unsigned int result = block(&chip.m_registers[0], &m_context);
+    chip.m_programCounter = result & 0xFFFF;
+    last = result >> 16;
+    // the block that wrote was the last one to run
+    if (m_context.writtenLength > 0) {
+        chip.m_stores++;
+        invalidate(m_context.writtenAddress, m_context.writtenLength);
+        m_context.writtenLength = 0;
+    }
+    return maxInstructions - m_context.budget;
+}
+
+// blocks are cached exactly as if execution had reached them
+// when a block stops in front of an instruction left to the interpreter,
+// execution comes back to the next one, so a block is translated there too
+void Jit::prepare(const Chip& chip, unsigned short start, unsigned short end) {
+    if (!ready())
+        return;
+    unsigned short address = start;
+    while (address < end && address <= 0x0FFE) {
+        int count = 0;
+        if (!m_blocks[address]) {
+            JitBlock block = translate(chip, address, count);
+            if (!block)
+                return;
+            m_blocks[address] = block;
+        }
+        // an instruction left to the interpreter gets an empty block
+        address += count > 0 ? 2 * count : 2;
+    }
+}
+
+#if defined(__x86_64__)
+
+// where the state around V0 - VF is, from V0
+static int stateField(size_t offset) {
+    return (int)offset - (int)offsetof(ChipState, m_registers);
+}
+
+const int indexField = stateField(offsetof(ChipState, m_indexRegister));
+const int memoryField = stateField(offsetof(ChipState, m_memory));
+const int stackField = stateField(offsetof(ChipState, m_stack));
+const int stackPointerField = stateField(offsetof(ChipState, m_stackPointer));
+const int keysField = stateField(offsetof(ChipState, m_keys));
+const int delayField = stateField(offsetof(ChipState, m_delayTimer));
+const int randomField = stateField(offsetof(ChipState, m_randomState));
+
+const int blocksField = offsetof(JitContext, blocks);
+const int budgetField = offsetof(JitContext, budget);
+const int backwardsField = offsetof(JitContext, backwards);
+const int writtenAddressField = offsetof(JitContext, writtenAddress);
+const int writtenLengthField = offsetof(JitContext, writtenLength);
+
+// condition codes of the two byte jcc rel32 forms
+const int JE = 0x84;
+const int JNE = 0x85;
+const int JBE = 0x86;
+const int JA = 0x87;
+const int JAE = 0x83;
+const int JL = 0x8C;
+const int JGE = 0x8D;
+const int JLE = 0x8E;
+
+// eax = 0, ecx = 1, edx = 2, and ah = 4 for byte operands, in the reg field
+// of a ModRM byte
+const int AL = 0;
+const int CL = 1;
+const int DL = 2;
+const int AH = 4;
+
+// appends raw machine code bytes to the block being translated
+class Emitter {
+  public:
+    explicit Emitter(Byte* code) : m_code(code), m_size(0) {}
+
+    size_t size() const { return m_size; }
+
+    void bytes(std::initializer_list<int> values) {
+        for (int value : values)
+            m_code[m_size++] = (Byte)value;
+    }
+
+    void imm16(unsigned short value) {
+        std::memcpy(m_code + m_size, &value, 2);
+        m_size += 2;
+    }
+
+    void imm32(unsigned int value) {
+        std::memcpy(m_code + m_size, &value, 4);
+        m_size += 4;
+    }
+
+    // the registers live at rdi, these are the addressing forms [rdi + V]
+    // for a register operand reg
+    void registerOperand(int opcode, int reg, Byte V) {
+        bytes({opcode, 0x47 | (reg << 3), V});
+    }
+
+    // [rdi + field], the rest of the state
+    void stateOperand(std::initializer_list<int> opcode, int reg, int field) {
+        bytes(opcode);
+        bytes({0x87 | (reg << 3)});
+        imm32(field);
+    }
+
+    // [rdi + rcx + field], memory at I with rcx holding I
+    void memoryOperand(std::initializer_list<int> opcode, int reg,
+                       int field) {
+        bytes(opcode);
+        bytes({0x84 | (reg << 3), 0x0F});
+        imm32(field);
+    }
+
+    // [rsi + field], the context
+    void contextOperand(std::initializer_list<int> opcode, int reg,
+                        int field) {
+        bytes(opcode);
+        bytes({0x46 | (reg << 3), field});
+    }
+
+    // jcc rel32 to wherever land() is called with what this returns
+    size_t branch(int condition) {
+        bytes({0x0F, condition});
+        size_t at = m_size;
+        imm32(0);
+        return at;
+    }
+
+    // cmp dword [rsi + budget], count + 1
+    // jl stop
+    // in front of the instruction after the first count of a block, which
+    // only runs if the budget covers it
+    size_t covered(int count) {
+        contextOperand({0x83}, 7, budgetField);
+        bytes({count + 1});
+        return branch(JL);
+    }
+
+    void land(size_t at) {
+        unsigned int offset = (unsigned int)(m_size - (at + 4));
+        std::memcpy(m_code + at, &offset, 4);
+    }
+
+    // mov eax, (last << 16) | pc
+    // ret
+    void exit(unsigned short pc, unsigned short last) {
+        bytes({0xB8});
+        imm32(((unsigned int)last << 16) | pc);
+        bytes({0xC3});
+    }
+
+    // the count of instructions the block ran comes off the budget
+    // sub dword [rsi + budget], count
+    void spend(int count) {
+        contextOperand({0x83}, 5, budgetField);
+        bytes({count});
+    }
+
+    // leaves for target, jumping straight into the block translated there
+    // while the budget lasts
+    // a backward jump, where last is the instruction jumping, returns
+    // instead unless the context lets it chain
+    void chain(unsigned short target, unsigned short last, int count) {
+        spend(count);
+        size_t spent = branch(JLE);
+        bool backward = target <= last;
+        size_t held = 0;
+        if (backward) {
+            // cmp byte [rsi + backwards], 0
+            contextOperand({0x80}, 7, backwardsField);
+            bytes({0});
+            held = branch(JE);
+        }
+        if (target <= 0x0FFE) {
+            // mov rax, [rsi + blocks]
+            // mov rax, [rax + target * 8]
+            // test rax, rax
+            // jz exit
+            // jmp rax
+            contextOperand({0x48, 0x8B}, AL, blocksField);
+            bytes({0x48, 0x8B, 0x80});
+            imm32(target * sizeof(JitBlock));
+            bytes({0x48, 0x85, 0xC0});
+            size_t missing = branch(JE);
+            bytes({0xFF, 0xE0});
+            land(missing);
+        }
+        land(spent);
+        if (backward)
+            land(held);
+        exit(target, last);
+    }
+
+    // chain() for a target only known at run time, in eax
+    void chainDynamic(unsigned short last, int count) {
+        spend(count);
+        size_t spent = branch(JLE);
+        // cmp byte [rsi + backwards], 0
+        // jne onwards
+        // cmp eax, last
+        // jbe exit
+        contextOperand({0x80}, 7, backwardsField);
+        bytes({0});
+        size_t onwards = branch(JNE);
+        bytes({0x3D});
+        imm32(last);
+        size_t held = branch(JBE);
+        land(onwards);
+        // cmp eax, 0x0FFE
+        // ja exit
+        // mov rdx, [rsi + blocks]
+        // mov rdx, [rdx + rax * 8]
+        // test rdx, rdx
+        // jz exit
+        // jmp rdx
+        bytes({0x3D});
+        imm32(0x0FFE);
+        size_t outside = branch(JA);
+        contextOperand({0x48, 0x8B}, DL, blocksField);
+        bytes({0x48, 0x8B, 0x14, 0xC2});
+        bytes({0x48, 0x85, 0xD2});
+        size_t missing = branch(JE);
+        bytes({0xFF, 0xE2});
+        land(spent);
+        land(held);
+        land(outside);
+        land(missing);
+        // or eax, last << 16
+        // ret
+        bytes({0x0D});
+        imm32((unsigned int)last << 16);
+        bytes({0xC3});
+    }
+
+    // goes on at pc + 4 if the condition holds, at pc + 2 otherwise, with
+    // the flags already set by a compare
+    void skip(int condition, unsigned short pc, int count) {
+        size_t taken = branch(condition);
+        chain(pc + 2, pc, count);
+        land(taken);
+        chain(pc + 4, pc, count);
+    }
+
+    // returns to the host whatever the budget, for it to deal with what
+    // the block wrote
+    void leave(unsigned short target, unsigned short last, int count) {
+        spend(count);
+        exit(target, last);
+    }
+
+  private:
+    Byte* m_code;
+    size_t m_size;
+};
+
+// translates instructions starting at address until something ends the block
+// each translation has the same semantics as its case in Chip::play(),
+// including the order in which VF is written, for the quirks profile of the
+// machine, which setQuirks() flushes the cache for
+JitBlock Jit::translate(const Chip& chip, unsigned short address,
+                        int& count) {
+    if (!m_code) {
+        void* memory = mmap(nullptr, codeBufferSize,
+                            PROT_READ | PROT_WRITE | PROT_EXEC,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            // no executable memory, so this machine only interprets
+            m_failed = true;
+            m_blocks.clear();
+            m_pages.clear();
+            return nullptr;
+        }
+        m_code = (Byte*)memory;
+    }
+    if (m_codeUsed + maxBlockInstructions * maxInstructionBytes >
+        codeBufferSize)
+        flush();
+
+    Emitter emit(m_code + m_codeUsed);
+    QuirkSet quirks = quirkSet(chip.m_quirks);
+    unsigned short pc = address;
+    count = 0;
+    bool open = true;
+    // branches out of the block in front of an instruction, with the
+    // instructions run before it, when the budget runs out or the
+    // instruction would go outside the stack or memory, which is left to
+    // the interpreter
+    struct Stop {
+        size_t at;
+        int count;
+        unsigned short pc;
+    };
+    std::vector<Stop> stops;
+
+    while (open) {
+        if (count == maxBlockInstructions || pc > 0x0FFE) {
+            emit.chain(pc, pc - 2, count);
+            break;
+        }
+        // the first instruction always runs, blocks are only entered with
+        // some budget left
+        if (count > 0)
+            stops.push_back({emit.covered(count), count, pc});
+
+        Opcode opcode =
+            (Opcode)((chip.m_memory[pc] << 8) | chip.m_memory[pc + 1]);
+        Byte X = (opcode & 0x0F00) >> 8;
+        Byte Y = (opcode & 0x00F0) >> 4;
+        Byte NN = opcode & 0x00FF;
+        unsigned short NNN = opcode & 0x0FFF;
+        // what FX55 and FX65 add to I
+        int increment = quirks.index == IndexQuirk::PlusX          ? X
+                        : quirks.index == IndexQuirk::PlusXPlusOne ? X + 1
+                                                                   : 0;
+        bool translated = true;
+
+        switch (opcode & 0xF000) {
+        case 0x0000:
+            if ((opcode & 0x00FF) != 0x00EE) {
+                translated = false;
+                break;
+            }
+            // 00EE
+            // cmp dword SP, 0
+            // jle stop
+            // dec dword SP
+            // movsxd rax, dword SP
+            // movzx eax, word [rdi + rax * 2 + stack]
+            // add ax, 2
+            // movzx eax, ax
+            emit.stateOperand({0x83}, 7, stackPointerField);
+            emit.bytes({0});
+            stops.push_back({emit.branch(JLE), count, pc});
+            emit.stateOperand({0xFF}, 1, stackPointerField);
+            emit.stateOperand({0x48, 0x63}, AL, stackPointerField);
+            emit.bytes({0x0F, 0xB7, 0x84, 0x47});
+            emit.imm32(stackField);
+            emit.bytes({0x66, 0x83, 0xC0, 0x02});
+            emit.bytes({0x0F, 0xB7, 0xC0});
+            emit.chainDynamic(pc, count + 1);
+            open = false;
+            break;
+        case 0x1000:
+            // 1NNN
+            emit.chain(NNN, pc, count + 1);
+            open = false;
+            break;
+        case 0x2000:
+            // 2NNN
+            // cmp dword SP, stack depth
+            // jge stop
+            // movsxd rax, dword SP
+            // mov word [rdi + rax * 2 + stack], pc
+            // inc dword SP
+            emit.stateOperand({0x83}, 7, stackPointerField);
+            emit.bytes({Chip::stackDepth});
+            stops.push_back({emit.branch(JGE), count, pc});
+            emit.stateOperand({0x48, 0x63}, AL, stackPointerField);
+            emit.bytes({0x66, 0xC7, 0x84, 0x47});
+            emit.imm32(stackField);
+            emit.imm16(pc);
+            emit.stateOperand({0xFF}, 0, stackPointerField);
+            emit.chain(NNN, pc, count + 1);
+            open = false;
+            break;
+        case 0x3000:
+            // 3XNN
+            // cmp byte [rdi + X], NN
+            emit.bytes({0x80, 0x7F, X, NN});
+            emit.skip(JE, pc, count + 1);
+            open = false;
+            break;
+        case 0x4000:
+            // 4XNN
+            emit.bytes({0x80, 0x7F, X, NN});
+            emit.skip(JNE, pc, count + 1);
+            open = false;
+            break;
+        case 0x5000:
+            // 5XY0
+            // mov al, VX
+            // cmp al, VY
+            emit.registerOperand(0x8A, AL, X);
+            emit.registerOperand(0x3A, AL, Y);
+            emit.skip(JE, pc, count + 1);
+            open = false;
+            break;
+        case 0x9000:
+            // 9XY0
+            emit.registerOperand(0x8A, AL, X);
+            emit.registerOperand(0x3A, AL, Y);
+            emit.skip(JNE, pc, count + 1);
+            open = false;
+            break;
+        case 0x6000:
+            // 6XNN
+            // mov byte [rdi + X], NN
+            emit.bytes({0xC6, 0x47, X, NN});
+            break;
+        case 0x7000:
+            // 7XNN
+            // add byte [rdi + X], NN
+            emit.bytes({0x80, 0x47, X, NN});
+            break;
+        case 0x8000:
+            switch (opcode & 0x000F) {
+            case 0x0000:
+                // 8XY0
+                // mov al, VY
+                // mov VX, al
+                emit.registerOperand(0x8A, AL, Y);
+                emit.registerOperand(0x88, AL, X);
+                break;
+            case 0x0001:
+            case 0x0002:
+            case 0x0003:
+                // 8XY1, 8XY2, 8XY3
+                // mov al, VY
+                // or / and / xor VX, al
+                // mov byte VF, 0, unless the profile leaves VF alone
+                emit.registerOperand(0x8A, AL, Y);
+                emit.registerOperand((opcode & 0x000F) == 0x0001   ? 0x08
+                                     : (opcode & 0x000F) == 0x0002 ? 0x20
+                                                                   : 0x30,
+                                     AL, X);
+                if (quirks.resetVF)
+                    emit.bytes({0xC6, 0x47, 0x0F, 0x00});
+                break;
+            case 0x0004:
+                // 8XY4
+                // mov al, VX
+                // add al, VY
+                // setc cl
+                // mov VF, cl
+                // mov al, VX
+                // add al, VY
+                // mov VX, al
+                emit.registerOperand(0x8A, AL, X);
+                emit.registerOperand(0x02, AL, Y);
+                emit.bytes({0x0F, 0x92, 0xC1});
+                emit.registerOperand(0x88, CL, 0x0F);
+                emit.registerOperand(0x8A, AL, X);
+                emit.registerOperand(0x02, AL, Y);
+                emit.registerOperand(0x88, AL, X);
+                break;
+            case 0x0005:
+            case 0x0007: {
+                // 8XY5, 8XY7
+                // mov al, minuend
+                // cmp al, subtrahend
+                // setae cl
+                // mov VF, cl
+                // mov al, minuend
+                // sub al, subtrahend
+                // mov VX, al
+                Byte minuend = (opcode & 0x000F) == 0x0005 ? X : Y;
+                Byte subtrahend = (opcode & 0x000F) == 0x0005 ? Y : X;
+                emit.registerOperand(0x8A, AL, minuend);
+                emit.registerOperand(0x3A, AL, subtrahend);
+                emit.bytes({0x0F, 0x93, 0xC1});
+                emit.registerOperand(0x88, CL, 0x0F);
+                emit.registerOperand(0x8A, AL, minuend);
+                emit.registerOperand(0x2A, AL, subtrahend);
+                emit.registerOperand(0x88, AL, X);
+            } break;
+            case 0x0006:
+                // 8XY6
+                // mov al, VY and mov VX, al first if the profile shifts VY
+                // mov al, VX
+                // and al, 1
+                // mov VF, al
+                // shr byte VX, 1
+                if (quirks.shiftVY) {
+                    emit.registerOperand(0x8A, AL, Y);
+                    emit.registerOperand(0x88, AL, X);
+                }
+                emit.registerOperand(0x8A, AL, X);
+                emit.bytes({0x24, 0x01});
+                emit.registerOperand(0x88, AL, 0x0F);
+                emit.bytes({0xD0, 0x6F, X});
+                break;
+            case 0x000E:
+                // 8XYE
+                // mov al, VY and mov VX, al first if the profile shifts VY
+                // mov al, VX
+                // shr al, 7
+                // mov VF, al
+                // shl byte VX, 1
+                if (quirks.shiftVY) {
+                    emit.registerOperand(0x8A, AL, Y);
+                    emit.registerOperand(0x88, AL, X);
+                }
+                emit.registerOperand(0x8A, AL, X);
+                emit.bytes({0xC0, 0xE8, 0x07});
+                emit.registerOperand(0x88, AL, 0x0F);
+                emit.bytes({0xD0, 0x67, X});
+                break;
+            default:
+                translated = false;
+                break;
+            }
+            break;
+        case 0xA000:
+            // ANNN
+            // mov word I, NNN
+            emit.stateOperand({0x66, 0xC7}, 0, indexField);
+            emit.imm16(NNN);
+            break;
+        case 0xB000:
+            // BNNN
+            // movzx eax, byte V0, or VX if the profile jumps from it
+            // add eax, NNN
+            emit.bytes({0x0F, 0xB6, 0x47, quirks.jumpVX ? X : 0});
+            emit.bytes({0x05});
+            emit.imm32(NNN);
+            emit.chainDynamic(pc, count + 1);
+            open = false;
+            break;
+        case 0xC000:
+            // CXNN
+            // the xorshift step of Chip::randomByte()
+            // mov eax, random
+            // mov ecx, eax, shl ecx, 13, xor eax, ecx
+            // mov ecx, eax, shr ecx, 17, xor eax, ecx
+            // mov ecx, eax, shl ecx, 5, xor eax, ecx
+            // mov random, eax
+            // shr eax, 24
+            // and al, NN
+            // mov VX, al
+            emit.stateOperand({0x8B}, AL, randomField);
+            emit.bytes({0x89, 0xC1, 0xC1, 0xE1, 0x0D, 0x31, 0xC8});
+            emit.bytes({0x89, 0xC1, 0xC1, 0xE9, 0x11, 0x31, 0xC8});
+            emit.bytes({0x89, 0xC1, 0xC1, 0xE1, 0x05, 0x31, 0xC8});
+            emit.stateOperand({0x89}, AL, randomField);
+            emit.bytes({0xC1, 0xE8, 0x18});
+            emit.bytes({0x24, NN});
+            emit.registerOperand(0x88, AL, X);
+            break;
+        case 0xE000:
+            if ((opcode & 0x000F) != 0x000E && (opcode & 0x000F) != 0x0001) {
+                translated = false;
+                break;
+            }
+            // EX9E, EXA1
+            // movzx ecx, byte VX
+            // xor eax, eax
+            // cmp ecx, 16
+            // jae test
+            // movzx eax, word keys
+            // shr eax, cl
+            // and eax, 1
+            // test: test eax, eax
+            emit.bytes({0x0F, 0xB6, 0x4F, X});
+            emit.bytes({0x31, 0xC0});
+            emit.bytes({0x83, 0xF9, 0x10});
+            {
+                size_t outside = emit.branch(JAE);
+                emit.stateOperand({0x0F, 0xB7}, AL, keysField);
+                emit.bytes({0xD3, 0xE8});
+                emit.bytes({0x83, 0xE0, 0x01});
+                emit.land(outside);
+            }
+            emit.bytes({0x85, 0xC0});
+            emit.skip((opcode & 0x000F) == 0x000E ? JNE : JE, pc, count + 1);
+            open = false;
+            break;
+        case 0xF000:
+            switch (opcode & 0x000F) {
+            case 0x0007:
+                // FX07
+                // mov al, delay
+                // mov VX, al
+                emit.stateOperand({0x8A}, AL, delayField);
+                emit.registerOperand(0x88, AL, X);
+                break;
+            case 0x0005:
+                switch (opcode & 0x00F0) {
+                case 0x0010:
+                    // FX15
+                    // mov al, VX
+                    // mov delay, al
+                    emit.registerOperand(0x8A, AL, X);
+                    emit.stateOperand({0x88}, AL, delayField);
+                    break;
+                case 0x0050:
+                    // FX55
+                    // movzx ecx, word I
+                    // cmp ecx, 0x0FFE - X
+                    // ja stop, where the writes or I would wrap around
+                    // mov word written address, cx
+                    // mov word written length, X + 1
+                    // mov al, Vi and mov [I + i], al for each register
+                    // add word I, increment
+                    emit.stateOperand({0x0F, 0xB7}, CL, indexField);
+                    emit.bytes({0x81, 0xF9});
+                    emit.imm32(0x0FFE - X);
+                    stops.push_back({emit.branch(JA), count, pc});
+                    emit.contextOperand({0x66, 0x89}, CL,
+                                        writtenAddressField);
+                    emit.contextOperand({0x66, 0xC7}, 0, writtenLengthField);
+                    emit.imm16(X + 1);
+                    for (int i = 0; i <= X; i++) {
+                        emit.registerOperand(0x8A, AL, i);
+                        emit.memoryOperand({0x88}, AL, memoryField + i);
+                    }
+                    if (increment > 0) {
+                        emit.stateOperand({0x66, 0x83}, 0, indexField);
+                        emit.bytes({increment});
+                    }
+                    emit.leave(pc + 2, pc, count + 1);
+                    open = false;
+                    break;
+                case 0x0060:
+                    // FX65
+                    // movzx ecx, word I
+                    // cmp ecx, 0x0FFE - X
+                    // ja stop, where the reads or I would wrap around
+                    // mov al, [I + i] and mov Vi, al for each register
+                    // add word I, increment
+                    emit.stateOperand({0x0F, 0xB7}, CL, indexField);
+                    emit.bytes({0x81, 0xF9});
+                    emit.imm32(0x0FFE - X);
+                    stops.push_back({emit.branch(JA), count, pc});
+                    for (int i = 0; i <= X; i++) {
+                        emit.memoryOperand({0x8A}, AL, memoryField + i);
+                        emit.registerOperand(0x88, AL, i);
+                    }
+                    if (increment > 0) {
+                        emit.stateOperand({0x66, 0x83}, 0, indexField);
+                        emit.bytes({increment});
+                    }
+                    break;
+                default:
+                    translated = false;
+                    break;
+                }
+                break;
+            case 0x0000:
+                if ((opcode & 0x00F0) != 0x0030) {
+                    translated = false;
+                    break;
+                }
+                // FX30
+                // movzx eax, byte VX
+                // and eax, 15
+                // imul eax, eax, 10
+                // add eax, bigFontAddress
+                // mov word I, ax
+                emit.bytes({0x0F, 0xB6, 0x47, X});
+                emit.bytes({0x83, 0xE0, 0x0F});
+                emit.bytes({0x6B, 0xC0, 0x0A});
+                emit.bytes({0x83, 0xC0, Chip::bigFontAddress});
+                emit.stateOperand({0x66, 0x89}, AL, indexField);
+                break;
+            case 0x000E:
+                // FX1E
+                // movzx eax, word I
+                // movzx ecx, byte VX
+                // add eax, ecx
+                // cmp eax, 0x0FFF
+                // seta cl
+                // mov VF, cl
+                // movzx eax, word I
+                // movzx ecx, byte VX
+                // add eax, ecx
+                // and eax, 0x0FFF
+                // mov word I, ax
+                emit.stateOperand({0x0F, 0xB7}, AL, indexField);
+                emit.bytes({0x0F, 0xB6, 0x4F, X});
+                emit.bytes({0x01, 0xC8});
+                emit.bytes({0x3D});
+                emit.imm32(0x0FFF);
+                emit.bytes({0x0F, 0x97, 0xC1});
+                emit.registerOperand(0x88, CL, 0x0F);
+                emit.stateOperand({0x0F, 0xB7}, AL, indexField);
+                emit.bytes({0x0F, 0xB6, 0x4F, X});
+                emit.bytes({0x01, 0xC8});
+                emit.bytes({0x25});
+                emit.imm32(Chip::addressMask);
+                emit.stateOperand({0x66, 0x89}, AL, indexField);
+                break;
+            case 0x0009:
+                // FX29
+                // movzx eax, byte VX
+                // lea eax, [rax + rax * 4]
+                // mov word I, ax
+                emit.bytes({0x0F, 0xB6, 0x47, X});
+                emit.bytes({0x8D, 0x04, 0x80});
+                emit.stateOperand({0x66, 0x89}, AL, indexField);
+                break;
+            case 0x0003:
+                // FX33
+                // movzx eax, byte VX
+                // movzx ecx, word I
+                // cmp ecx, 0x0FFD
+                // ja stop, where the writes would wrap around
+                // mov word written address, cx
+                // mov word written length, 3
+                // mov dl, 10
+                // div dl
+                // mov [I + 2], ah
+                // movzx eax, al
+                // div dl
+                // mov [I + 1], ah
+                // mov [I], al
+                emit.bytes({0x0F, 0xB6, 0x47, X});
+                emit.stateOperand({0x0F, 0xB7}, CL, indexField);
+                emit.bytes({0x81, 0xF9});
+                emit.imm32(0x0FFD);
+                stops.push_back({emit.branch(JA), count, pc});
+                emit.contextOperand({0x66, 0x89}, CL, writtenAddressField);
+                emit.contextOperand({0x66, 0xC7}, 0, writtenLengthField);
+                emit.imm16(3);
+                emit.bytes({0xB2, 0x0A});
+                emit.bytes({0xF6, 0xF2});
+                emit.memoryOperand({0x88}, AH, memoryField + 2);
+                emit.bytes({0x0F, 0xB6, 0xC0});
+                emit.bytes({0xF6, 0xF2});
+                emit.memoryOperand({0x88}, AH, memoryField + 1);
+                emit.memoryOperand({0x88}, AL, memoryField);
+                emit.leave(pc + 2, pc, count + 1);
+                open = false;
+                break;
+            default:
+                translated = false;
+                break;
+            }
+            break;
+        default:
+            translated = false;
+            break;
+        }
+
+        if (!translated) {
+            // leave this one to the interpreter, from the empty block that
+            // is cached for it
+            if (count > 0)
+                emit.chain(pc, pc - 2, count);
+            else
+                emit.exit(pc, 0);
+            break;
+        }
+
+        count++;
+        pc += 2;
+    }
+
+    // the block returns in front of the instruction it stopped at, which
+    // is interpreted if it is the first
+    for (const Stop& stop : stops) {
+        emit.land(stop.at);
+        if (stop.count > 0)
+            emit.leave(stop.pc, stop.pc - 2, stop.count);
+        else
+            emit.exit(stop.pc, 0);
+    }
+
+    // nothing at this address could be translated, an empty block is still
+    // cached so the lookup is not repeated
+    JitBlock block = (JitBlock)(m_code + m_codeUsed);
+    m_codeUsed += emit.size();
+    Span span = {address, (unsigned short)(address + 2 * std::max(count, 1))};
+    for (int page = span.start / pageSize; page <= (span.end - 1) / pageSize;
+         page++)
+        m_pages[page].push_back(span);
+    return block;
+}
+
+#else
+
+JitBlock Jit::translate(const Chip& chip, unsigned short address,
+                        int& count) {
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,124 @@
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "../includes/keymap.hpp"
+
+// the key names a keymap file can use, as spelled in sf::Keyboard
+static bool keyFromName(const std::string& name, sf::Keyboard::Key& key) {
+    if (name.size() == 1 && name[0] >= 'A' && name[0] <= 'Z') {
+        key = (sf::Keyboard::Key)(sf::Keyboard::A + (name[0] - 'A'));
+        return true;
+    }
+    if (name.size() == 4 && name.compare(0, 3, "Num") == 0 &&
+        name[3] >= '0' && name[3] <= '9') {
+        key = (sf::Keyboard::Key)(sf::Keyboard::Num0 + (name[3] - '0'));
+        return true;
+    }
+    if (name.size() == 7 && name.compare(0, 6, "Numpad") == 0 &&
+        name[6] >= '0' && name[6] <= '9') {
+        key = (sf::Keyboard::Key)(sf::Keyboard::Numpad0 + (name[6] - '0'));
+        return true;
+    }
+
+    static const struct {
+        const char* name;
+        sf::Keyboard::Key key;
+    } namedKeys[] = {
+        {"Space", sf::Keyboard::Space},   {"Enter", sf::Keyboard::Enter},
+        {"Tab", sf::Keyboard::Tab},       {"Left", sf::Keyboard::Left},
+        {"Right", sf::Keyboard::Right},   {"Up", sf::Keyboard::Up},
+        {"Down", sf::Keyboard::Down},     {"LShift", sf::Keyboard::LShift},
+        {"RShift", sf::Keyboard::RShift}, {"LControl", sf::Keyboard::LControl},
+        {"RControl", sf::Keyboard::RControl},
+        {"LAlt", sf::Keyboard::LAlt},     {"RAlt", sf::Keyboard::RAlt},
+        {"Comma", sf::Keyboard::Comma},   {"Period", sf::Keyboard::Period},
+        {"Slash", sf::Keyboard::Slash},
+        {"Semicolon", sf::Keyboard::Semicolon},
+    };
+    for (const auto& named : namedKeys) {
+        if (name == named.name) {
+            key = named.key;
+            return true;
+        }
+    }
+    return false;
+}
+
+// keys the emulator itself answers to, see main(), which can't also be a
+// CHIP-8 key
+static bool reserved(sf::Keyboard::Key key) {
+    return key == sf::Keyboard::Tab || key == sf::Keyboard::BackSpace ||
+           key == sf::Keyboard::F9 || key == sf::Keyboard::F10 ||
+           key == sf::Keyboard::PageUp || key == sf::Keyboard::PageDown;
+}
+
+Keymap::Keymap() : m_chipKeys(sf::Keyboard::KeyCount, -1) {
+    bind(0x1, sf::Keyboard::Num1);
+    bind(0x2, sf::Keyboard::Num2);
+    bind(0x3, sf::Keyboard::Num3);
+    bind(0xC, sf::Keyboard::Num4);
+    bind(0x4, sf::Keyboard::Q);
+    bind(0x5, sf::Keyboard::W);
+    bind(0x6, sf::Keyboard::E);
+    bind(0xD, sf::Keyboard::R);
+    bind(0x7, sf::Keyboard::A);
+    bind(0x8, sf::Keyboard::S);
+    bind(0x9, sf::Keyboard::D);
+    bind(0xE, sf::Keyboard::F);
+    bind(0xA, sf::Keyboard::Z);
+    bind(0x0, sf::Keyboard::X);
+    bind(0xB, sf::Keyboard::C);
+    bind(0xF, sf::Keyboard::V);
+}
+
+void Keymap::bind(int chipKey, sf::Keyboard::Key key) {
+    // a CHIP-8 key has exactly one host key, drop its old binding
+    for (auto& bound : m_chipKeys) {
+        if (bound == chipKey)
+            bound = -1;
+    }
+    m_chipKeys[key] = chipKey;
+}
+
+// keys the file doesn't mention keep their default binding
+// the file is parsed into a copy, so one with an error changes nothing
+bool Keymap::loadFromFile(const std::string& filepath) {
+    std::ifstream file(filepath);
+    if (!file.is_open()) {
+        std::cerr << "Failed to load keymap\n";
+        return false;
+    }
+
+    Keymap parsed = *this;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string chipKeyName;
+        std::string keyName;
+        if (!(fields >> chipKeyName))
+            continue;
+
+        sf::Keyboard::Key key;
+        int chipKey = -1;
+        if (chipKeyName.size() == 1 && std::isxdigit(chipKeyName[0]))
+            chipKey = std::stoi(chipKeyName, nullptr, 16);
+        if (chipKey < 0 || !(fields >> keyName) || !keyFromName(keyName, key)) {
+            std::cerr << "Invalid keymap entry on line " << lineNumber
+                      << "\n";
+            return false;
+        }
+        if (reserved(key)) {
+            std::cerr << keyName << " is reserved by the emulator, on line "
+                      << lineNumber << "\n";
+            return false;
+        }
+        parsed.bind(chipKey, key);
+    }
+    *this = parsed;
+    return true;
+}
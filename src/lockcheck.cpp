@@ -0,0 +1,97 @@
+#include <cstring>
+
+#include "../includes/lockstep.hpp"
+#include "../includes/romlibrary.hpp"
+
+// checks that lockstep changes nothing
+// every ROM runs under every quirks profile on a set of lanes in lockstep
+// and on as many lone machines, each lane with its own seed and keys, and
+// every lane has to end in exactly the state of its lone machine
+// exits with ROM_LOAD_ERR if any lane differs
+
+// lanes are given different keys at different times, so they go different
+// ways and meet up again
+static unsigned short laneKeys(int frame, int lane) {
+    if ((frame / 6 + lane) % 3)
+        return 0;
+    return 1 << ((frame / 12 + lane * 5) % 16);
+}
+
+// frames of input as the emulator would feed a lone machine
+static void runAlone(Chip& chip, int instructionsPerFrame) {
+    int budget = instructionsPerFrame;
+    while (budget > 0) {
+        RunResult run = chip.run(budget);
+        budget -= run.instructions + run.skipped;
+        if (run.reason == StopReason::WaitingForKey ||
+            run.reason == StopReason::IllegalOpcode)
+            budget = 0;
+    }
+}
+
+int main() {
+    const int lanes = 16;
+    const int frames = 300;
+    const int instructionsPerFrame = 100;
+    const std::string profiles[] = {"modern", "vip", "chip48", "schip"};
+
+    RomLibrary library;
+    if (!library.scan("./roms/"))
+        exit(ROM_LOAD_ERR);
+
+    int failures = 0;
+    for (const std::string& profile : profiles) {
+        Quirks quirks;
+        Chip::quirksFromName(profile, quirks);
+        for (size_t rom = 0; rom < library.size(); rom++) {
+            if (!library[rom].fits)
+                continue;
+            const std::vector<Byte>& image = library[rom].image;
+            Chip prototype;
+            prototype.setQuirks(quirks);
+            if (!prototype.loadROM(image.data(), image.size()))
+                exit(ROM_LOAD_ERR);
+
+            Lockstep lockstep(prototype, lanes);
+            std::vector<Chip> alone(lanes, prototype);
+            for (int lane = 0; lane < lanes; lane++) {
+                lockstep.machine(lane).seedRandom(100 + lane);
+                alone[lane].seedRandom(100 + lane);
+            }
+
+            for (int frame = 0; frame < frames; frame++) {
+                for (int lane = 0; lane < lanes; lane++) {
+                    lockstep.machine(lane).m_keys = laneKeys(frame, lane);
+                    alone[lane].m_keys = laneKeys(frame, lane);
+                }
+                lockstep.run(instructionsPerFrame);
+                lockstep.tickTimers();
+                for (int lane = 0; lane < lanes; lane++) {
+                    runAlone(alone[lane], instructionsPerFrame);
+                    alone[lane].tickTimers();
+                    // a lane does not stop at a draw, so neither flag
+                    // says anything by the end of a frame
+                    lockstep.machine(lane).m_drawFlag = false;
+                    alone[lane].m_drawFlag = false;
+                }
+            }
+
+            int differing = 0;
+            for (int lane = 0; lane < lanes; lane++) {
+                ChipState a, b;
+                lockstep.machine(lane).saveState(a);
+                alone[lane].saveState(b);
+                differing += std::memcmp(&a, &b, sizeof(ChipState)) != 0;
+            }
+            std::cout << profile << " " << library[rom].name << ": "
+                      << (differing ? "MISMATCH in " : "ok");
+            if (differing)
+                std::cout << differing << " of " << lanes << " lanes";
+            std::cout << "\n";
+            failures += differing > 0;
+        }
+    }
+
+    std::cout << (failures ? "FAILED\n" : "All lanes identical\n");
+    return failures ? ROM_LOAD_ERR : 0;
+}
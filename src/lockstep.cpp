@@ -0,0 +1,435 @@
+#include <algorithm>
+
+#include "../includes/lockstep.hpp"
+
+Lockstep::Lockstep(const Chip& prototype, size_t lanes)
+    : m_machines(lanes, prototype), m_registers(16 * lanes),
+      m_indexRegister(lanes), m_programCounter(lanes), m_remaining(lanes),
+      m_groups(sizeof(prototype.m_memory) + 1),
+      m_code(std::begin(prototype.m_memory), std::end(prototype.m_memory)),
+      m_shared(sizeof(prototype.m_memory), true),
+      m_quirks(quirkSet(prototype.m_quirks)) {
+    // every lane goes through play() when it leaves the arrays
+    for (Chip& chip : m_machines)
+        chip.setEngine(Engine::Switch);
+    for (size_t lane = 0; lane < lanes; lane++)
+        load(lane);
+}
+
+void Lockstep::load(size_t lane) {
+    const Chip& chip = m_machines[lane];
+    for (int i = 0; i < 16; i++)
+        registers(i)[lane] = chip.m_registers[i];
+    m_indexRegister[lane] = chip.m_indexRegister;
+    m_programCounter[lane] = chip.m_programCounter;
+}
+
+void Lockstep::store(size_t lane) {
+    Chip& chip = m_machines[lane];
+    for (int i = 0; i < 16; i++)
+        chip.m_registers[i] = registers(i)[lane];
+    chip.m_indexRegister = m_indexRegister[lane];
+    chip.m_programCounter = m_programCounter[lane];
+}
+
+void Lockstep::join(unsigned int lane) {
+    int pc = std::min<int>(m_programCounter[lane], m_groups.size() - 1);
+    if (m_groups[pc].empty())
+        m_pending.push(pc);
+    m_groups[pc].push_back(lane);
+}
+
+long long Lockstep::run(int maxInstructions) {
+    for (size_t lane = 0; lane < lanes(); lane++) {
+        const Chip& chip = m_machines[lane];
+        load(lane);
+        // the lanes Chip::run() would return from straight away
+        m_remaining[lane] =
+            chip.m_faulted || !chip.keyWaitOver() ? 0 : maxInstructions;
+        if (m_remaining[lane] > 0)
+            join(lane);
+    }
+
+    long long executed = 0;
+    while (!m_pending.empty()) {
+        // the group on the lowest program counter goes next, its lanes
+        // move on to the groups at wherever the instruction took them
+        int pc = m_pending.top();
+        m_pending.pop();
+        m_active.clear();
+        m_active.swap(m_groups[pc]);
+
+        bool decodable = pc < 0x0FFF && m_shared[pc] && m_shared[pc + 1];
+        bool handled = false;
+        if (decodable) {
+            Opcode opcode = (Opcode)((m_code[pc] << 8) | m_code[pc + 1]);
+            if (m_active.size() == lanes())
+                handled = execute(opcode, AllLanes{(unsigned int)lanes()});
+            else
+                handled = execute(opcode, m_active);
+        }
+        if (!handled) {
+            for (unsigned int lane : m_active)
+                interpret(lane);
+        }
+        executed += m_active.size();
+
+        // a group that stayed together moves on as it is
+        int next = m_programCounter[m_active.front()];
+        bool together = next < 0x0FFF;
+        for (unsigned int lane : m_active) {
+            m_remaining[lane]--;
+            together &= m_remaining[lane] > 0 &&
+                        m_programCounter[lane] == next;
+        }
+        if (together && m_groups[next].empty()) {
+            m_pending.push(next);
+            m_groups[next].swap(m_active);
+            continue;
+        }
+        for (unsigned int lane : m_active)
+            if (m_remaining[lane] > 0)
+                join(lane);
+    }
+
+    for (size_t lane = 0; lane < lanes(); lane++)
+        store(lane);
+    return executed;
+}
+
+void Lockstep::tickTimers() {
+    for (Chip& chip : m_machines)
+        chip.tickTimers();
+}
+
+void Lockstep::interpret(size_t lane) {
+    Chip& chip = m_machines[lane];
+    store(lane);
+
+    // FX33 and FX55 are the only opcodes that write memory
+    unsigned short pc = chip.m_programCounter;
+    if (pc < 0x0FFF) {
+        Opcode opcode = (Opcode)((chip.m_memory[pc] << 8) |
+                                 chip.m_memory[pc + 1]);
+        if ((opcode & 0xF00F) == 0xF003)
+            written(chip.m_indexRegister, 3);
+        else if ((opcode & 0xF0FF) == 0xF055)
+            written(chip.m_indexRegister, ((opcode & 0x0F00) >> 8) + 1);
+    }
+
+    chip.step();
+    load(lane);
+
+    // stops the lane where Chip::run() would
+    if (chip.m_faulted || chip.m_keyWait != KeyWait::None)
+        m_remaining[lane] = 0;
+}
+
+// where FX55 and FX65 leave I in the lanes that executed them
+template <class Lanes>
+void Lockstep::advanceIndex(Byte X, const Lanes& group) {
+    int increment = m_quirks.index == IndexQuirk::PlusX          ? X
+                    : m_quirks.index == IndexQuirk::PlusXPlusOne ? X + 1
+                                                                 : 0;
+    for (unsigned int l : group)
+        m_indexRegister[l] =
+            (m_indexRegister[l] + increment) & Chip::addressMask;
+}
+
+// whatever a lane writes may now differ between lanes
+void Lockstep::written(unsigned short address, int length) {
+    for (int i = 0; i < length; i++)
+        m_shared[(address + i) & Chip::addressMask] = false;
+}
+
+// each case has the same semantics as its case in Chip::play()
+// where an opcode writes both VF and VX they are written in the same order
+// as play(), which matters when X is F
+// opcodes that touch the stack, memory, the display, timers or keys go to
+// each lane's Chip directly, without copying the registers back and forth
+template <class Lanes>
+bool Lockstep::execute(Opcode opcode, const Lanes& group) {
+    unsigned short* pc = m_programCounter.data();
+    unsigned short* I = m_indexRegister.data();
+    Byte* VX = registers((opcode & 0x0F00) >> 8);
+    Byte* VY = registers((opcode & 0x00F0) >> 4);
+    Byte* VF = registers(0x000F);
+    Byte X = (opcode & 0x0F00) >> 8;
+    Byte N = opcode & 0x000F;
+    Byte NN = opcode & 0x00FF;
+    unsigned short NNN = opcode & 0x0FFF;
+
+    switch (opcode & 0xF000) {
+    case 0x0000:
+        switch (opcode & 0x00FF) {
+        case 0x00E0:
+            // 00E0
+            for (unsigned int l : group)
+                m_machines[l].clearScreen();
+            break;
+        case 0x00EE:
+            // 00EE
+            // a lane with nothing on the stack faults in play()
+            for (unsigned int l : group)
+                if (m_machines[l].m_stackPointer <= 0)
+                    return false;
+            for (unsigned int l : group) {
+                Chip& chip = m_machines[l];
+                chip.m_stackPointer--;
+                pc[l] = chip.m_stack[chip.m_stackPointer];
+            }
+            break;
+        default:
+            return false;
+        }
+        break;
+    case 0x1000:
+        // 1NNN
+        for (unsigned int l : group)
+            pc[l] = NNN;
+        return true;
+    case 0x2000:
+        // 2NNN
+        // a lane with the stack full faults in play()
+        for (unsigned int l : group)
+            if (m_machines[l].m_stackPointer >= Chip::stackDepth)
+                return false;
+        for (unsigned int l : group) {
+            Chip& chip = m_machines[l];
+            chip.m_stack[chip.m_stackPointer] = pc[l];
+            chip.m_stackPointer++;
+            pc[l] = NNN;
+        }
+        return true;
+    case 0x3000:
+        // 3XNN
+        for (unsigned int l : group)
+            pc[l] += VX[l] == NN ? 4 : 2;
+        return true;
+    case 0x4000:
+        // 4XNN
+        for (unsigned int l : group)
+            pc[l] += VX[l] != NN ? 4 : 2;
+        return true;
+    case 0x5000:
+        // 5XY0
+        for (unsigned int l : group)
+            pc[l] += VX[l] == VY[l] ? 4 : 2;
+        return true;
+    case 0x9000:
+        // 9XY0
+        for (unsigned int l : group)
+            pc[l] += VX[l] != VY[l] ? 4 : 2;
+        return true;
+    case 0x6000:
+        // 6XNN
+        for (unsigned int l : group)
+            VX[l] = NN;
+        break;
+    case 0x7000:
+        // 7XNN
+        for (unsigned int l : group)
+            VX[l] += NN;
+        break;
+    case 0x8000:
+        switch (opcode & 0x000F) {
+        case 0x0000:
+            // 8XY0
+            for (unsigned int l : group)
+                VX[l] = VY[l];
+            break;
+        case 0x0001:
+            // 8XY1
+            for (unsigned int l : group)
+                VX[l] |= VY[l];
+            if (m_quirks.resetVF)
+                for (unsigned int l : group)
+                    VF[l] = 0;
+            break;
+        case 0x0002:
+            // 8XY2
+            for (unsigned int l : group)
+                VX[l] &= VY[l];
+            if (m_quirks.resetVF)
+                for (unsigned int l : group)
+                    VF[l] = 0;
+            break;
+        case 0x0003:
+            // 8XY3
+            for (unsigned int l : group)
+                VX[l] ^= VY[l];
+            if (m_quirks.resetVF)
+                for (unsigned int l : group)
+                    VF[l] = 0;
+            break;
+        case 0x0004:
+            // 8XY4
+            for (unsigned int l : group)
+                VF[l] = VX[l] + VY[l] > 0x00FF;
+            for (unsigned int l : group)
+                VX[l] = (Byte)(VX[l] + VY[l]);
+            break;
+        case 0x0005:
+            // 8XY5
+            for (unsigned int l : group)
+                VF[l] = VX[l] >= VY[l];
+            for (unsigned int l : group)
+                VX[l] = (Byte)(VX[l] - VY[l]);
+            break;
+        case 0x0006:
+            // 8XY6
+            if (m_quirks.shiftVY)
+                for (unsigned int l : group)
+                    VX[l] = VY[l];
+            for (unsigned int l : group)
+                VF[l] = VX[l] & 0x0001;
+            for (unsigned int l : group)
+                VX[l] >>= 1;
+            break;
+        case 0x0007:
+            // 8XY7
+            for (unsigned int l : group)
+                VF[l] = VY[l] >= VX[l];
+            for (unsigned int l : group)
+                VX[l] = (Byte)(VY[l] - VX[l]);
+            break;
+        case 0x000E:
+            // 8XYE
+            if (m_quirks.shiftVY)
+                for (unsigned int l : group)
+                    VX[l] = VY[l];
+            for (unsigned int l : group)
+                VF[l] = VX[l] >> 7;
+            for (unsigned int l : group)
+                VX[l] = (Byte)(VX[l] << 1);
+            break;
+        default:
+            return false;
+        }
+        break;
+    case 0xA000:
+        // ANNN
+        for (unsigned int l : group)
+            I[l] = NNN;
+        break;
+    case 0xB000:
+        // BNNN
+        for (unsigned int l : group)
+            pc[l] = NNN + registers(m_quirks.jumpVX ? X : 0)[l];
+        return true;
+    case 0xC000:
+        // CXNN
+        for (unsigned int l : group)
+            VX[l] = m_machines[l].randomByte() & NN;
+        break;
+    case 0xD000:
+        // DXYN
+        // the sprite is read from memory at I and VF is set by drawSprite()
+        for (unsigned int l : group) {
+            Chip& chip = m_machines[l];
+            chip.m_indexRegister = I[l];
+            if (m_quirks.clipSprites)
+                chip.drawSprite<true>(VX[l], VY[l], N);
+            else
+                chip.drawSprite<false>(VX[l], VY[l], N);
+            VF[l] = chip.m_registers[0x000F];
+        }
+        break;
+    case 0xE000:
+        switch (opcode & 0x000F) {
+        case 0x000E:
+            // EX9E
+            for (unsigned int l : group)
+                pc[l] += m_machines[l].isKeyDown(VX[l]) ? 4 : 2;
+            return true;
+        case 0x0001:
+            // EXA1
+            for (unsigned int l : group)
+                pc[l] += !m_machines[l].isKeyDown(VX[l]) ? 4 : 2;
+            return true;
+        default:
+            return false;
+        }
+    case 0xF000:
+        switch (opcode & 0x000F) {
+        case 0x0007:
+            // FX07
+            for (unsigned int l : group)
+                VX[l] = m_machines[l].m_delayTimer;
+            break;
+        case 0x0005:
+            switch (opcode & 0x00F0) {
+            case 0x0010:
+                // FX15
+                for (unsigned int l : group)
+                    m_machines[l].m_delayTimer = VX[l];
+                break;
+            case 0x0050:
+                // FX55
+                for (unsigned int l : group) {
+                    Chip& chip = m_machines[l];
+                    for (int i = 0; i <= (int)X; i++)
+                        chip.m_memory[(I[l] + i) & Chip::addressMask] =
+                            registers(i)[l];
+                    written(I[l], X + 1);
+                    chip.m_stores++;
+                }
+                advanceIndex(X, group);
+                break;
+            case 0x0060:
+                // FX65
+                for (unsigned int l : group) {
+                    const Chip& chip = m_machines[l];
+                    for (int i = 0; i <= (int)X; i++)
+                        registers(i)[l] =
+                            chip.m_memory[(I[l] + i) & Chip::addressMask];
+                }
+                advanceIndex(X, group);
+                break;
+            default:
+                return false;
+            }
+            break;
+        case 0x0008:
+            // FX18
+            for (unsigned int l : group)
+                m_machines[l].m_soundTimer = VX[l];
+            break;
+        case 0x0003:
+            // FX33
+            for (unsigned int l : group) {
+                Chip& chip = m_machines[l];
+                int value = VX[l];
+                chip.m_memory[(I[l] + 2) & Chip::addressMask] = value % 10;
+                value /= 10;
+                chip.m_memory[(I[l] + 1) & Chip::addressMask] = value % 10;
+                value /= 10;
+                chip.m_memory[I[l] & Chip::addressMask] = value % 10;
+                written(I[l], 3);
+                chip.m_stores++;
+            }
+            break;
+        case 0x000E:
+            // FX1E
+            for (unsigned int l : group)
+                VF[l] = I[l] + VX[l] > 0x0FFF;
+            for (unsigned int l : group)
+                I[l] = (I[l] + VX[l]) & Chip::addressMask;
+            break;
+        case 0x0009:
+            // FX29
+            for (unsigned int l : group)
+                I[l] = VX[l] * 5;
+            break;
+        default:
+            return false;
+        }
+        break;
+    default:
+        return false;
+    }
+
+    for (unsigned int l : group)
+        pc[l] += 2;
+    return true;
+}
@@ -1,55 +1,33 @@
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
-#include <unordered_map>
 
-#include <SFML/Audio.hpp>
 #include <SFML/Graphics.hpp>
 
+#include "../includes/beeper.hpp"
+#include "../includes/capture.hpp"
 #include "../includes/chip.hpp"
+#include "../includes/keymap.hpp"
+#include "../includes/renderer.hpp"
+#include "../includes/rewind.hpp"
+#include "../includes/romlibrary.hpp"
+#include "../includes/triplebuffer.hpp"
 
+// on screen size of a 128x64 pixel, the window is sized from the renderer
 const int pixelScale = 10;
-const int width = 64;
-const int height = 32;
-
-sf::SoundBuffer buffer;
-sf::Sound beep;
-std::unordered_map<Byte, sf::Keyboard::Key> mapKeys;
 
 auto primaryColor = sf::Color::White;
 auto secondaryColor = sf::Color::Black;
 
-void mapKeysToKeyboard() {
-    mapKeys[0x1] = sf::Keyboard::Num1;
-    mapKeys[0x2] = sf::Keyboard::Num2;
-    mapKeys[0x3] = sf::Keyboard::Num3;
-    mapKeys[0xC] = sf::Keyboard::Num4;
-    mapKeys[0x4] = sf::Keyboard::Q;
-    mapKeys[0x5] = sf::Keyboard::W;
-    mapKeys[0x6] = sf::Keyboard::E;
-    mapKeys[0xD] = sf::Keyboard::R;
-    mapKeys[0x7] = sf::Keyboard::A;
-    mapKeys[0x8] = sf::Keyboard::S;
-    mapKeys[0x9] = sf::Keyboard::D;
-    mapKeys[0xE] = sf::Keyboard::F;
-    mapKeys[0xA] = sf::Keyboard::Z;
-    mapKeys[0x0] = sf::Keyboard::X;
-    mapKeys[0xB] = sf::Keyboard::C;
-    mapKeys[0xF] = sf::Keyboard::V;
-}
-
-void drawToScreen(sf::RenderWindow& target, Chip& chip) {
-    sf::Vector2f pixelSize(pixelScale, pixelScale);
-    sf::RectangleShape pixel(pixelSize);
-    for (int i = 0; i < height; i++) {
-        for (int j = 0; j < width; j++) {
-            if (chip.m_frameBuffer[(i * width) + j])
-                pixel.setFillColor(primaryColor);
-            else
-                pixel.setFillColor(secondaryColor);
-            pixel.setPosition(j * pixelScale, i * pixelScale);
-            target.draw(pixel);
-        }
-    }
+// the analysis follows both ways out of every skip, so this may be a path
+// the program never takes, ./disasm lists them all
+static void reportIllegal(const Analysis& analysis) {
+    if (!analysis.illegal().empty())
+        std::cout << "Warning: illegal opcode reachable at 0x" << std::hex
+                  << analysis.illegal()[0] << std::dec << "\n";
 }
 
 int main(int argc, char* argv[]) {
@@ -58,80 +36,340 @@ int main(int argc, char* argv[]) {
         exit(ROM_LOAD_ERR);
     }
 
-    if (!buffer.loadFromFile("./sounds/beep.wav"))
-        std::cout << "Failed to load sound\n";
-    else
-        beep.setBuffer(buffer);
-
-    mapKeysToKeyboard();
-
-    std::string filepath = "./roms/" + std::string(argv[1]);
+    // the whole roms folder is read once, resets and switches between ROMs
+    // never touch the disk again
+    RomLibrary library;
+    if (!library.scan("./roms/"))
+        exit(ROM_LOAD_ERR);
+    int rom = library.find(argv[1]);
+    if (rom < 0) {
+        std::cerr << "Failed to load ROM\n";
+        exit(ROM_LOAD_ERR);
+    }
 
-    if (argc > 2) {
-        if (std::string(argv[2]) == std::string("alt")) {
+    Engine engine = Engine::Switch;
+    int instructionsPerFrame = Chip::defaultInstructionsPerFrame;
+    Keymap keymap;
+    bool seeded = false;
+    uint32_t seed = 0;
+    // F9 starts and stops tracing into this file, trace= also starts it
+    // right away
+    std::string tracePath = "trace.c8t";
+    bool tracing = false;
+    // F10 does the same for recording the display, with capture=
+    std::string capturePath = "capture.c8v";
+    bool capturing = false;
+    for (int i = 2; i < argc; i++) {
+        std::string option(argv[i]);
+        if (option == std::string("alt")) {
             primaryColor = sf::Color::Green;
+        } else if (option.rfind("engine=", 0) == 0) {
+            if (!Chip::engineFromName(option.substr(7), engine))
+                std::cout << "Invalid engine specified - using defaults\n";
+        } else if (option.rfind("ipf=", 0) == 0) {
+            instructionsPerFrame = std::atoi(option.substr(4).c_str());
+            if (instructionsPerFrame <= 0) {
+                std::cout << "Invalid instructions per frame - using "
+                             "defaults\n";
+                instructionsPerFrame = Chip::defaultInstructionsPerFrame;
+            }
+        } else if (option.rfind("seed=", 0) == 0) {
+            seed = (uint32_t)std::strtoul(option.substr(5).c_str(), nullptr,
+                                          10);
+            seeded = true;
+        } else if (option.rfind("quirks=", 0) == 0) {
+            // every ROM gets the profile it was detected as otherwise
+            Quirks quirks;
+            if (Chip::quirksFromName(option.substr(7), quirks))
+                library.setQuirks(quirks);
+            else
+                std::cout << "Invalid quirks specified - using defaults\n";
+        } else if (option.rfind("trace=", 0) == 0) {
+            tracePath = option.substr(6);
+            tracing = true;
+        } else if (option.rfind("capture=", 0) == 0) {
+            capturePath = option.substr(8);
+            capturing = true;
+        } else if (option.rfind("keymap=", 0) == 0) {
+            if (!keymap.loadFromFile(option.substr(7)))
+                std::cout << "Invalid keymap specified - using defaults\n";
         } else {
             std::cout << "Invalid color mode specified - using defaults\n";
         }
     }
 
     Chip chip;
-    bool loaded = chip.loadROM(filepath);
-    if (!loaded)
+    if (seeded)
+        chip.seedRandom(seed);
+    chip.setEngine(engine);
+    const Analysis* analysis = library.load(chip, rom);
+    if (!analysis)
         exit(ROM_LOAD_ERR);
+    reportIllegal(*analysis);
 
     // chip.debug_dumpMem();
 
+    Renderer renderer(pixelScale, primaryColor, secondaryColor);
     sf::RenderWindow window(
-        sf::VideoMode(width * pixelScale, height * pixelScale),
-        "CHIPPER - " + std::string(argv[1]));
+        sf::VideoMode(renderer.size().x, renderer.size().y),
+        "CHIPPER - " + library[rom].name);
+    window.setVerticalSyncEnabled(true);
+    window.setKeyRepeatEnabled(false);
+
+    Beeper beeper;
+
+    // the emulator runs on its own thread so presenting, which can block on
+    // vsync, never holds it up
+    // everything it shares with this thread is lock-free: frames go out
+    // through a triple buffer, keys come in as a bitmask, one bit per key
+    // the one exception is a halted machine, which sleeps on a condition
+    // variable until the next input event instead of running empty frames
+    TripleBuffer<Frame> frames;
+    std::atomic<unsigned short> keyMask(0);
+    std::atomic<bool> resetRequested(false);
+    // index of the ROM to switch to, -1 when no switch is pending
+    std::atomic<int> romRequested(-1);
+    std::atomic<bool> rewinding(false);
+    std::atomic<bool> traceToggled(tracing);
+    Tracer tracer;
+    std::atomic<bool> captureToggled(capturing);
+    Capture capture;
+    std::atomic<bool> soundActive(false);
+    std::atomic<bool> running(true);
+    std::mutex inputLock;
+    std::condition_variable inputChanged;
+    // bumped after every input event, under the lock
+    std::atomic<unsigned int> inputEvents(0);
+
+    std::thread emulator([&] {
+        // everything runs in 60hz frames: a fixed budget of instructions,
+        // one timer tick, at most one published frame, then sleep until the
+        // next deadline
+        const auto frameDuration = std::chrono::microseconds(16667);
+        auto nextFrame = std::chrono::steady_clock::now();
+        // what is left of the frame's instructions, runs stop exactly on
+        // it so it is back to 0 when the frame ends
+        int budget = 0;
+        // the last minute of frames, only ever touched on this thread
+        Rewind rewind;
+        ChipState past;
+        int current = rom;
+
+        while (running.load(std::memory_order_relaxed)) {
+            // read before the keys, so an event that comes after they are
+            // read is always noticed below
+            unsigned int seenEvents = inputEvents.load();
+            int requested = romRequested.exchange(-1);
+            bool reset = resetRequested.exchange(false);
+            if (requested >= 0) {
+                current = requested;
+                reset = true;
+            }
+            if (traceToggled.exchange(false)) {
+                if (tracer.active()) {
+                    chip.m_tracer = nullptr;
+                    tracer.stop();
+                    std::cout << "Trace written to " << tracePath << ", "
+                              << tracer.dropped() << " records dropped\n";
+                } else if (tracer.start(tracePath)) {
+                    chip.m_tracer = &tracer;
+                    std::cout << "Tracing to " << tracePath << "\n";
+                } else {
+                    std::cout << "Failed to open " << tracePath << "\n";
+                }
+            }
+            if (captureToggled.exchange(false)) {
+                if (capture.active()) {
+                    capture.stop();
+                    std::cout << "Capture written to " << capturePath
+                              << ", " << capture.dropped()
+                              << " frames dropped\n";
+                } else if (capture.start(capturePath)) {
+                    std::cout << "Capturing to " << capturePath << "\n";
+                } else {
+                    std::cout << "Failed to open " << capturePath << "\n";
+                }
+            }
+            if (reset) {
+                chip.reset();
+                const Analysis* analysis = library.load(chip, current);
+                if (!analysis)
+                    exit(ROM_LOAD_ERR);
+                reportIllegal(*analysis);
+                chip.m_drawFlag = true;
+                rewind.clear();
+                budget = 0;
+            }
+
+            if (rewinding.load(std::memory_order_relaxed)) {
+                // one frame back per frame held, the machine stays where it
+                // is once the history runs out
+                if (rewind.stepBack(past)) {
+                    chip.loadState(past);
+                    chip.m_drawFlag = true;
+                }
+                budget = 0;
+            } else {
+                // the state the frame starts from, so the first step back
+                // already undoes this frame rather than landing on the
+                // state it ends in
+                rewind.capture(chip);
+                chip.m_keys = keyMask.load(std::memory_order_relaxed);
+
+                budget += instructionsPerFrame;
+                while (budget > 0) {
+                    RunResult result = chip.run(budget);
+                    budget -= result.instructions + result.skipped;
+                    if (result.reason == StopReason::WaitingForKey) {
+                        // keys only change between frames, nothing more
+                        // can happen in this one
+                        budget = 0;
+                    } else if (result.reason == StopReason::IllegalOpcode) {
+                        // the machine stays halted on the opcode until it is
+                        // reset, only the first stop reports it
+                        if (result.instructions > 0) {
+                            std::cerr << "Illegal opcode encountered! "
+                                      << std::hex << chip.m_faultOpcode
+                                      << " at " << chip.m_programCounter
+                                      << std::dec << "\n";
+                        }
+                        budget = 0;
+                    }
+                }
+                chip.tickTimers();
+            }
+
+            if (chip.m_drawFlag) {
+                Frame& frame = frames.writeBuffer();
+                std::copy(std::begin(chip.m_frameBuffer),
+                          std::end(chip.m_frameBuffer), frame.words);
+                frame.hires = chip.m_hires;
+                frames.publish();
+                chip.m_drawFlag = false;
+            }
+            // every frame is recorded, drawn or not, so the video keeps time
+            if (capture.active())
+                capture.record(chip.m_frameBuffer, chip.m_hires);
+            soundActive.store(chip.m_soundTimer > 0,
+                              std::memory_order_relaxed);
+
+            if (!chip.keyWaitOver() && chip.m_delayTimer == 0 &&
+                chip.m_soundTimer == 0 && !rewinding.load()) {
+                // halted in FX0A with no timer left to count down, every
+                // frame would be the same as this one until the input
+                // changes, so sleep until it does
+                auto halted = std::chrono::steady_clock::now();
+                std::unique_lock<std::mutex> lock(inputLock);
+                inputChanged.wait(lock, [&] {
+                    return inputEvents.load() != seenEvents ||
+                           !running.load();
+                });
+                nextFrame = std::chrono::steady_clock::now();
+                // the recording still lasts as long as the display did
+                if (capture.active())
+                    capture.skip((uint32_t)((nextFrame - halted) /
+                                            frameDuration));
+                continue;
+            }
+
+            nextFrame += frameDuration;
+            auto now = std::chrono::steady_clock::now();
+            if (nextFrame < now) {
+                // too far behind to catch up, drop the missed frames
+                // instead of running them back to back
+                if (now - nextFrame > frameDuration)
+                    nextFrame = now;
+            } else {
+                std::this_thread::sleep_until(nextFrame);
+            }
+        }
+    });
+
+    // the key state only changes on key events, the keyboard itself is
+    // never polled
+    unsigned int keys = 0;
+    // the emulator thread picks this up at the start of its next frame
+    int selected = rom;
+
+    // wakes the emulator thread if it is asleep on a halted machine
+    auto notifyInput = [&] {
+        {
+            std::lock_guard<std::mutex> lock(inputLock);
+            inputEvents++;
+        }
+        inputChanged.notify_one();
+    };
 
     while (window.isOpen()) {
         sf::Event event;
+        bool input = false;
         while (window.pollEvent(event)) {
-            if (event.type == sf::Event::Closed)
+            if (event.type == sf::Event::KeyPressed ||
+                event.type == sf::Event::KeyReleased ||
+                event.type == sf::Event::LostFocus)
+                input = true;
+            switch (event.type) {
+            case sf::Event::Closed:
                 window.close();
+                break;
+            case sf::Event::KeyPressed: {
+                if (event.key.code == sf::Keyboard::BackSpace)
+                    resetRequested.store(true);
+                if (event.key.code == sf::Keyboard::Tab)
+                    rewinding.store(true);
+                if (event.key.code == sf::Keyboard::F9)
+                    traceToggled.store(true);
+                if (event.key.code == sf::Keyboard::F10)
+                    captureToggled.store(true);
+                if (event.key.code == sf::Keyboard::PageUp ||
+                    event.key.code == sf::Keyboard::PageDown) {
+                    selected = library.next(
+                        selected,
+                        event.key.code == sf::Keyboard::PageDown ? 1 : -1);
+                    romRequested.store(selected);
+                    window.setTitle("CHIPPER - " + library[selected].name);
+                }
+                int key = keymap.chipKey(event.key.code);
+                if (key >= 0)
+                    keys |= 1u << key;
+            } break;
+            case sf::Event::KeyReleased: {
+                if (event.key.code == sf::Keyboard::Tab)
+                    rewinding.store(false);
+                int key = keymap.chipKey(event.key.code);
+                if (key >= 0)
+                    keys &= ~(1u << key);
+            } break;
+            case sf::Event::LostFocus:
+                // releases never arrive while unfocused, so let go of
+                // everything rather than leave keys stuck down
+                keys = 0;
+                rewinding.store(false);
+                break;
+            default:
+                break;
+            }
         }
+        keyMask.store(keys, std::memory_order_relaxed);
+        if (input)
+            notifyInput();
 
-        chip.play();
+        beeper.setActive(soundActive.load(std::memory_order_relaxed));
 
-        if (chip.m_drawFlag) {
+        if (frames.update()) {
+            renderer.update(frames.readBuffer());
             window.clear();
-            drawToScreen(window, chip);
-            chip.m_drawFlag = false;
+            renderer.draw(window);
             window.display();
+        } else {
+            // nothing new to show, check input again shortly
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
         }
-
-        if (chip.m_soundTimer)
-            beep.play();
-
-        chip.m_keys[0x0] = sf::Keyboard::isKeyPressed(mapKeys[0x0]);
-        chip.m_keys[0x1] = sf::Keyboard::isKeyPressed(mapKeys[0x1]);
-        chip.m_keys[0x2] = sf::Keyboard::isKeyPressed(mapKeys[0x2]);
-        chip.m_keys[0x3] = sf::Keyboard::isKeyPressed(mapKeys[0x3]);
-        chip.m_keys[0x4] = sf::Keyboard::isKeyPressed(mapKeys[0x4]);
-        chip.m_keys[0x5] = sf::Keyboard::isKeyPressed(mapKeys[0x5]);
-        chip.m_keys[0x6] = sf::Keyboard::isKeyPressed(mapKeys[0x6]);
-        chip.m_keys[0x7] = sf::Keyboard::isKeyPressed(mapKeys[0x7]);
-        chip.m_keys[0x8] = sf::Keyboard::isKeyPressed(mapKeys[0x8]);
-        chip.m_keys[0x9] = sf::Keyboard::isKeyPressed(mapKeys[0x9]);
-        chip.m_keys[0xA] = sf::Keyboard::isKeyPressed(mapKeys[0xA]);
-        chip.m_keys[0xB] = sf::Keyboard::isKeyPressed(mapKeys[0xB]);
-        chip.m_keys[0xC] = sf::Keyboard::isKeyPressed(mapKeys[0xC]);
-        chip.m_keys[0xD] = sf::Keyboard::isKeyPressed(mapKeys[0xD]);
-        chip.m_keys[0xE] = sf::Keyboard::isKeyPressed(mapKeys[0xE]);
-        chip.m_keys[0xF] = sf::Keyboard::isKeyPressed(mapKeys[0xF]);
-
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::BackSpace)) {
-            chip.reset();
-            bool loaded = chip.loadROM(filepath);
-            if (!loaded)
-                exit(ROM_LOAD_ERR);
-        }
-
-        // TODO: change this to actually push a frame every 16.67ms
-        // std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
 
+    running.store(false);
+    notifyInput();
+    emulator.join();
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "../includes/chip.hpp"
+
+// build time generator for the embedded ROM pack
+// writes every ROM in a directory into a C++ source file, under the same
+// rules as RomLibrary::scan(), so a build with CHIPPER_EMBED_ROMS starts
+// without reading the directory
+
+struct Rom {
+    std::string name;
+    std::vector<unsigned char> image;
+};
+
+// names go into string literals
+static std::string escape(const std::string& name) {
+    std::string escaped;
+    for (char c : name) {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: ./packroms [ROM directory] [source file]\n";
+        exit(ROM_LOAD_ERR);
+    }
+
+    std::error_code error;
+    std::filesystem::directory_iterator files(argv[1], error);
+    if (error) {
+        std::cerr << "Failed to read ROM directory " << argv[1] << "\n";
+        exit(ROM_LOAD_ERR);
+    }
+    std::vector<Rom> roms;
+    for (const auto& file : files) {
+        if (!file.is_regular_file())
+            continue;
+        Rom rom;
+        rom.name = file.path().filename().string();
+        if (rom.name == "README.md")
+            continue;
+        std::ifstream input(file.path(), std::ios::in | std::ios::binary);
+        if (!input.is_open())
+            continue;
+        rom.image.assign(std::istreambuf_iterator<char>(input),
+                         std::istreambuf_iterator<char>());
+        roms.push_back(std::move(rom));
+    }
+    std::sort(roms.begin(), roms.end(), [](const Rom& a, const Rom& b) {
+        return a.name < b.name;
+    });
+
+    std::ofstream source(argv[2]);
+    source << "// generated by packroms from " << argv[1]
+           << ", do not edit\n\n#include \"includes/rompack.hpp\"\n";
+    for (size_t i = 0; i < roms.size(); i++) {
+        source << "\nstatic const unsigned char rom" << i << "[] = {";
+        const std::vector<unsigned char>& image = roms[i].image;
+        for (size_t j = 0; j < image.size(); j++) {
+            source << (j % 12 == 0 ? "\n    " : " ") << (int)image[j]
+                   << ",";
+        }
+        // an empty file still needs an array
+        if (image.empty())
+            source << "0";
+        source << "\n};\n";
+    }
+
+    source << "\nconst EmbeddedRom embeddedRoms[] = {\n";
+    for (size_t i = 0; i < roms.size(); i++)
+        source << "    {\"" << escape(roms[i].name) << "\", rom" << i << ", "
+               << roms[i].image.size() << "},\n";
+    if (roms.empty())
+        source << "    {nullptr, nullptr, 0},\n";
+    source << "};\n\nconst size_t embeddedRomCount = " << roms.size()
+           << ";\n";
+    if (!source) {
+        std::cerr << "Failed to write " << argv[2] << "\n";
+        exit(ROM_LOAD_ERR);
+    }
+    std::cout << "Packed " << roms.size() << " ROMs into " << argv[2]
+              << "\n";
+    return 0;
+}
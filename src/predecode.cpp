@@ -0,0 +1,604 @@
+#include <algorithm>
+
+#include "../includes/chip.hpp"
+
+// predecoded engine
+// every memory address gets an Instruction holding a handler and the operands
+// of the opcode found there, so executing it is a single indirect call with
+// no fetch, no nested switch and no nibble extraction
+// each handler mirrors its case in Chip::play(), and returns false after
+// anything Chip::run() has to look at, so run() only checks the machine
+// between runs of handlers rather than after every instruction
+// jumps backwards are only looked at while run() fast-forwards idle loops
+
+// 00E0
+static bool op00E0(Chip& chip, const Instruction& ins) {
+    chip.clearScreen();
+    chip.m_programCounter += 2;
+    return false;
+}
+
+// 00EE
+static bool op00EE(Chip& chip, const Instruction& ins) {
+    if (chip.m_stackPointer <= 0) {
+        chip.illegalOpcode(ins.opcode);
+        return false;
+    }
+    unsigned short pc = chip.m_programCounter;
+    chip.m_stackPointer--;
+    chip.m_programCounter = chip.m_stack[chip.m_stackPointer];
+    chip.m_programCounter += 2;
+    return chip.m_programCounter > pc || !chip.m_fastForward;
+}
+
+// 00CN
+static bool op00CN(Chip& chip, const Instruction& ins) {
+    chip.scrollDown(ins.N);
+    chip.m_programCounter += 2;
+    return false;
+}
+
+// 00FB
+static bool op00FB(Chip& chip, const Instruction& ins) {
+    chip.scrollRight();
+    chip.m_programCounter += 2;
+    return false;
+}
+
+// 00FC
+static bool op00FC(Chip& chip, const Instruction& ins) {
+    chip.scrollLeft();
+    chip.m_programCounter += 2;
+    return false;
+}
+
+// 00FD
+// stays on this instruction until the machine is reset
+static bool op00FD(Chip& chip, const Instruction& ins) { return false; }
+
+// 00FE
+static bool op00FE(Chip& chip, const Instruction& ins) {
+    chip.setHires(false);
+    chip.m_programCounter += 2;
+    return false;
+}
+
+// 00FF
+static bool op00FF(Chip& chip, const Instruction& ins) {
+    chip.setHires(true);
+    chip.m_programCounter += 2;
+    return false;
+}
+
+// 1NNN
+static bool op1NNN(Chip& chip, const Instruction& ins) {
+    bool forward = ins.NNN > chip.m_programCounter;
+    chip.m_programCounter = ins.NNN;
+    return forward || !chip.m_fastForward;
+}
+
+// 2NNN
+static bool op2NNN(Chip& chip, const Instruction& ins) {
+    if (chip.m_stackPointer >= Chip::stackDepth) {
+        chip.illegalOpcode(ins.opcode);
+        return false;
+    }
+    chip.m_stack[chip.m_stackPointer] = chip.m_programCounter;
+    chip.m_stackPointer++;
+    bool forward = ins.NNN > chip.m_programCounter;
+    chip.m_programCounter = ins.NNN;
+    return forward || !chip.m_fastForward;
+}
+
+// 3XNN
+static bool op3XNN(Chip& chip, const Instruction& ins) {
+    chip.m_programCounter += chip.m_registers[ins.X] == ins.NN ? 4 : 2;
+    return true;
+}
+
+// 4XNN
+static bool op4XNN(Chip& chip, const Instruction& ins) {
+    chip.m_programCounter += chip.m_registers[ins.X] != ins.NN ? 4 : 2;
+    return true;
+}
+
+// 5XY0
+static bool op5XY0(Chip& chip, const Instruction& ins) {
+    chip.m_programCounter +=
+        chip.m_registers[ins.X] == chip.m_registers[ins.Y] ? 4 : 2;
+    return true;
+}
+
+// 6XNN
+static bool op6XNN(Chip& chip, const Instruction& ins) {
+    chip.m_registers[ins.X] = ins.NN;
+    chip.m_programCounter += 2;
+    return true;
+}
+
+// 7XNN
+static bool op7XNN(Chip& chip, const Instruction& ins) {
+    chip.m_registers[ins.X] += ins.NN;
+    chip.m_programCounter += 2;
+    return true;
+}
+
+// 8XY0
+static bool op8XY0(Chip& chip, const Instruction& ins) {
+    chip.m_registers[ins.X] = chip.m_registers[ins.Y];
+    chip.m_programCounter += 2;
+    return true;
+}
+
+// 8XY1
+template <class Policy>
+static bool op8XY1(Chip& chip, const Instruction& ins) {
+    chip.m_registers[ins.X] |= chip.m_registers[ins.Y];
+    if (Policy::resetVF)
+        chip.m_registers[0x000F] = 0;
+    chip.m_programCounter += 2;
+    return true;
+}
+
+// 8XY2
+template <class Policy>
+static bool op8XY2(Chip& chip, const Instruction& ins) {
+    chip.m_registers[ins.X] &= chip.m_registers[ins.Y];
+    if (Policy::resetVF)
+        chip.m_registers[0x000F] = 0;
+    chip.m_programCounter += 2;
+    return true;
+}
+
+// 8XY3
+template <class Policy>
+static bool op8XY3(Chip& chip, const Instruction& ins) {
+    chip.m_registers[ins.X] ^= chip.m_registers[ins.Y];
+    if (Policy::resetVF)
+        chip.m_registers[0x000F] = 0;
+    chip.m_programCounter += 2;
+    return true;
+}
+
+// 8XY4
+// VF is written before the sum, exactly like the switch engine, so X or Y
+// being F behaves the same in both
+static bool op8XY4(Chip& chip, const Instruction& ins) {
+    Byte* V = &chip.m_registers[0];
+    V[0x000F] = V[ins.X] + V[ins.Y] > 0x00FF ? 1 : 0;
+    V[ins.X] = (Byte)(V[ins.X] + V[ins.Y]);
+    chip.m_programCounter += 2;
+    return true;
+}
+
+// 8XY5
+static bool op8XY5(Chip& chip, const Instruction& ins) {
+    Byte* V = &chip.m_registers[0];
+    V[0x000F] = V[ins.X] < V[ins.Y] ? 0 : 1;
+    V[ins.X] = (Byte)(V[ins.X] - V[ins.Y]);
+    chip.m_programCounter += 2;
+    return true;
+}
+
+// 8XY6
+template <class Policy>
+static bool op8XY6(Chip& chip, const Instruction& ins) {
+    Byte* V = &chip.m_registers[0];
+    if (Policy::shiftVY)
+        V[ins.X] = V[ins.Y];
+    V[0x000F] = V[ins.X] & 0x0001;
+    V[ins.X] = (Byte)V[ins.X] >> 1;
+    chip.m_programCounter += 2;
+    return true;
+}
+
+// 8XY7
+static bool op8XY7(Chip& chip, const Instruction& ins) {
+    Byte* V = &chip.m_registers[0];
+    V[0x000F] = V[ins.Y] < V[ins.X] ? 0 : 1;
+    V[ins.X] = (Byte)(V[ins.Y] - V[ins.X]);
+    chip.m_programCounter += 2;
+    return true;
+}
+
+// 8XYE
+template <class Policy>
+static bool op8XYE(Chip& chip, const Instruction& ins) {
+    Byte* V = &chip.m_registers[0];
+    if (Policy::shiftVY)
+        V[ins.X] = V[ins.Y];
+    V[0x000F] = (V[ins.X] & 0x0080) >> 7;
+    V[ins.X] = (Byte)(V[ins.X] << 1);
+    chip.m_programCounter += 2;
+    return true;
+}
+
+// 9XY0
+static bool op9XY0(Chip& chip, const Instruction& ins) {
+    chip.m_programCounter +=
+        chip.m_registers[ins.X] != chip.m_registers[ins.Y] ? 4 : 2;
+    return true;
+}
+
+// ANNN
+static bool opANNN(Chip& chip, const Instruction& ins) {
+    chip.m_indexRegister = ins.NNN;
+    chip.m_programCounter += 2;
+    return true;
+}
+
+// BNNN
+template <class Policy>
+static bool opBNNN(Chip& chip, const Instruction& ins) {
+    unsigned short pc = chip.m_programCounter;
+    chip.m_programCounter =
+        ins.NNN + chip.m_registers[Policy::jumpVX ? ins.X : 0];
+    return chip.m_programCounter > pc || !chip.m_fastForward;
+}
+
+// CXNN
+static bool opCXNN(Chip& chip, const Instruction& ins) {
+    unsigned short randomNumber = chip.randomByte();
+    chip.m_registers[ins.X] = randomNumber & ins.NN;
+    chip.m_programCounter += 2;
+    return true;
+}
+
+// DXYN
+template <class Policy>
+static bool opDXYN(Chip& chip, const Instruction& ins) {
+    chip.drawSprite<Policy::clipSprites>(chip.m_registers[ins.X],
+                                         chip.m_registers[ins.Y], ins.N);
+    chip.m_programCounter += 2;
+    return false;
+}
+
+// EX9E
+static bool opEX9E(Chip& chip, const Instruction& ins) {
+    chip.m_programCounter +=
+        chip.isKeyDown(chip.m_registers[ins.X]) ? 4 : 2;
+    return true;
+}
+
+// EXA1
+static bool opEXA1(Chip& chip, const Instruction& ins) {
+    chip.m_programCounter +=
+        !chip.isKeyDown(chip.m_registers[ins.X]) ? 4 : 2;
+    return true;
+}
+
+// FX07
+static bool opFX07(Chip& chip, const Instruction& ins) {
+    chip.m_registers[ins.X] = chip.m_delayTimer;
+    chip.m_programCounter += 2;
+    return true;
+}
+
+// FX0A
+static bool opFX0A(Chip& chip, const Instruction& ins) {
+    chip.waitForKey(ins.X);
+    return false;
+}
+
+// FX15
+static bool opFX15(Chip& chip, const Instruction& ins) {
+    chip.m_delayTimer = chip.m_registers[ins.X];
+    chip.m_programCounter += 2;
+    return true;
+}
+
+// FX18
+static bool opFX18(Chip& chip, const Instruction& ins) {
+    chip.m_soundTimer = chip.m_registers[ins.X];
+    chip.m_programCounter += 2;
+    return false;
+}
+
+// FX1E
+static bool opFX1E(Chip& chip, const Instruction& ins) {
+    chip.m_registers[0x000F] = 0;
+    if (chip.m_indexRegister + chip.m_registers[ins.X] > 0x0FFF)
+        chip.m_registers[0x000F] = 1;
+    chip.m_indexRegister =
+        (chip.m_indexRegister + chip.m_registers[ins.X]) & Chip::addressMask;
+    chip.m_programCounter += 2;
+    return true;
+}
+
+// FX29
+static bool opFX29(Chip& chip, const Instruction& ins) {
+    chip.m_indexRegister = chip.m_registers[ins.X] * 5;
+    chip.m_programCounter += 2;
+    return true;
+}
+
+// FX30
+static bool opFX30(Chip& chip, const Instruction& ins) {
+    chip.m_indexRegister =
+        Chip::bigFontAddress + (chip.m_registers[ins.X] & 0xF) * 10;
+    chip.m_programCounter += 2;
+    return true;
+}
+
+// FX33
+// writes memory, so any decoded instruction overlapping it is dropped
+static bool opFX33(Chip& chip, const Instruction& ins) {
+    int VX = chip.m_registers[ins.X];
+    unsigned short I = chip.m_indexRegister;
+    chip.m_memory[(I + 2) & Chip::addressMask] = VX % 10;
+    VX /= 10;
+    chip.m_memory[(I + 1) & Chip::addressMask] = VX % 10;
+    VX /= 10;
+    chip.m_memory[I & Chip::addressMask] = VX % 10;
+    chip.invalidateDecoded(I, 3);
+    chip.m_stores++;
+    chip.m_programCounter += 2;
+    return true;
+}
+
+// FX55
+// writes memory, so any decoded instruction overlapping it is dropped,
+// which can be this one, so X is kept out of the table first
+template <class Policy>
+static bool opFX55(Chip& chip, const Instruction& ins) {
+    Byte X = ins.X;
+    for (int i = 0; i <= (int)X; i++) {
+        chip.m_memory[(chip.m_indexRegister + i) & Chip::addressMask] =
+            chip.m_registers[i];
+    }
+    chip.invalidateDecoded(chip.m_indexRegister, X + 1);
+    chip.advanceIndex<Policy>(X);
+    chip.m_stores++;
+    chip.m_programCounter += 2;
+    return true;
+}
+
+// FX65
+template <class Policy>
+static bool opFX65(Chip& chip, const Instruction& ins) {
+    for (int i = 0; i <= (int)ins.X; i++) {
+        chip.m_registers[i] =
+            chip.m_memory[(chip.m_indexRegister + i) & Chip::addressMask];
+    }
+    chip.advanceIndex<Policy>(ins.X);
+    chip.m_programCounter += 2;
+    return true;
+}
+
+// FX75
+static bool opFX75(Chip& chip, const Instruction& ins) {
+    for (int i = 0; i <= (int)ins.X && i < 8; i++) {
+        chip.m_flags[i] = chip.m_registers[i];
+    }
+    chip.m_stores++;
+    chip.m_programCounter += 2;
+    return true;
+}
+
+// FX85
+static bool opFX85(Chip& chip, const Instruction& ins) {
+    for (int i = 0; i <= (int)ins.X && i < 8; i++) {
+        chip.m_registers[i] = chip.m_flags[i];
+    }
+    chip.m_programCounter += 2;
+    return true;
+}
+
+static bool opIllegal(Chip& chip, const Instruction& ins) {
+    chip.illegalOpcode(ins.opcode);
+    return false;
+}
+
+// where the program counter has gone past the last address a whole
+// instruction can be fetched from, halts like Chip::fetch()'s 0000 does
+static const Instruction pastMemory = {opIllegal, 0, 0, 0, 0, 0, 0};
+
+// picks the handler for an opcode, the same decoding tree as Chip::play()
+// handlers for opcodes the profiles disagree on are instantiated per profile
+template <class Policy> static Handler handlerFor(Opcode opcode) {
+    switch (opcode & 0xF000) {
+    case 0x0000:
+        switch (opcode & 0x00FF) {
+        case 0x00E0:
+            return op00E0;
+        case 0x00EE:
+            return op00EE;
+        case 0x00FB:
+            return op00FB;
+        case 0x00FC:
+            return op00FC;
+        case 0x00FD:
+            return op00FD;
+        case 0x00FE:
+            return op00FE;
+        case 0x00FF:
+            return op00FF;
+        default:
+            if ((opcode & 0x00F0) == 0x00C0)
+                return op00CN;
+            return opIllegal;
+        }
+    case 0x1000:
+        return op1NNN;
+    case 0x2000:
+        return op2NNN;
+    case 0x3000:
+        return op3XNN;
+    case 0x4000:
+        return op4XNN;
+    case 0x5000:
+        return op5XY0;
+    case 0x6000:
+        return op6XNN;
+    case 0x7000:
+        return op7XNN;
+    case 0x8000:
+        switch (opcode & 0x000F) {
+        case 0x0000:
+            return op8XY0;
+        case 0x0001:
+            return op8XY1<Policy>;
+        case 0x0002:
+            return op8XY2<Policy>;
+        case 0x0003:
+            return op8XY3<Policy>;
+        case 0x0004:
+            return op8XY4;
+        case 0x0005:
+            return op8XY5;
+        case 0x0006:
+            return op8XY6<Policy>;
+        case 0x0007:
+            return op8XY7;
+        case 0x000E:
+            return op8XYE<Policy>;
+        default:
+            return opIllegal;
+        }
+    case 0x9000:
+        return op9XY0;
+    case 0xA000:
+        return opANNN;
+    case 0xB000:
+        return opBNNN<Policy>;
+    case 0xC000:
+        return opCXNN;
+    case 0xD000:
+        return opDXYN<Policy>;
+    case 0xE000:
+        switch (opcode & 0x000F) {
+        case 0x000E:
+            return opEX9E;
+        case 0x0001:
+            return opEXA1;
+        default:
+            return opIllegal;
+        }
+    case 0xF000:
+        switch (opcode & 0x000F) {
+        case 0x0007:
+            return opFX07;
+        case 0x000A:
+            return opFX0A;
+        case 0x0005:
+            switch (opcode & 0x00F0) {
+            case 0x0010:
+                return opFX15;
+            case 0x0050:
+                return opFX55<Policy>;
+            case 0x0060:
+                return opFX65<Policy>;
+            case 0x0070:
+                return opFX75;
+            case 0x0080:
+                return opFX85;
+            default:
+                return opIllegal;
+            }
+        case 0x0000:
+            if ((opcode & 0x00F0) == 0x0030)
+                return opFX30;
+            return opIllegal;
+        case 0x0008:
+            return opFX18;
+        case 0x000E:
+            return opFX1E;
+        case 0x0009:
+            return opFX29;
+        case 0x0003:
+            return opFX33;
+        default:
+            return opIllegal;
+        }
+    default:
+        return opIllegal;
+    }
+}
+
+Instruction decode(Opcode opcode, Quirks quirks) {
+    Instruction instruction;
+    switch (quirks) {
+    case Quirks::CosmacVip:
+        instruction.handler = handlerFor<CosmacVipQuirks>(opcode);
+        break;
+    case Quirks::Chip48:
+        instruction.handler = handlerFor<Chip48Quirks>(opcode);
+        break;
+    case Quirks::SuperChip:
+        instruction.handler = handlerFor<SuperChipQuirks>(opcode);
+        break;
+    case Quirks::Modern:
+    default:
+        instruction.handler = handlerFor<ModernQuirks>(opcode);
+        break;
+    }
+    instruction.opcode = opcode;
+    instruction.X = (opcode & 0x0F00) >> 8;
+    instruction.Y = (opcode & 0x00F0) >> 4;
+    instruction.N = opcode & 0x000F;
+    instruction.NN = opcode & 0x00FF;
+    instruction.NNN = opcode & 0x0FFF;
+    return instruction;
+}
+
+bool legal(Opcode opcode) {
+    return handlerFor<ModernQuirks>(opcode) != opIllegal;
+}
+
+// runs a copy, the instruction may write over its own table entry
+bool decodeAndExecute(Chip& chip, const Instruction& instruction) {
+    unsigned short pc = chip.m_programCounter;
+    Opcode opcode =
+        (Opcode)((chip.m_memory[pc] << 8) | chip.m_memory[pc + 1]);
+    Instruction decoded = decode(opcode, chip.m_quirks);
+    chip.m_decoded[pc] = decoded;
+    decoded.handler(chip, decoded);
+    // run() looks at anything that has just been decoded
+    return false;
+}
+
+// resets the whole table so every address is decoded again on first use
+void Chip::invalidateDecoded() {
+    Instruction stub = {decodeAndExecute, 0, 0, 0, 0, 0, 0};
+    m_decoded.assign(sizeof(m_memory), stub);
+}
+
+// drops every decoded instruction that reads a byte in the written range
+// an instruction starting one byte before the range overlaps it too
+void Chip::invalidateDecoded(unsigned short address, unsigned short length) {
+    if (m_decoded.empty())
+        return;
+    // a write that wraps around the end of memory also wrote the start
+    int size = m_decoded.size();
+    if (address + length > size) {
+        invalidateDecoded(0, address + length - size);
+        length = size - address;
+    }
+    Instruction stub = {decodeAndExecute, 0, 0, 0, 0, 0, 0};
+    int first = address > 0 ? address - 1 : 0;
+    int last = std::min((int)address + length, (int)m_decoded.size());
+    for (int i = first; i < last; i++)
+        m_decoded[i] = stub;
+}
+
+// fetch and decode already happened, only execute
+void Chip::playPredecoded() {
+    const Instruction& instruction =
+        m_programCounter <= 0x0FFE ? m_decoded[m_programCounter] : pastMemory;
+    instruction.handler(*this, instruction);
+}
+
+// the handlers are called one after another with nothing in between, until
+// one returns false
+int Chip::playPredecoded(int maxInstructions, unsigned short& pc) {
+    int executed = 0;
+    bool more = true;
+    while (more && executed < maxInstructions) {
+        pc = m_programCounter;
+        const Instruction& instruction =
+            pc <= 0x0FFE ? m_decoded[pc] : pastMemory;
+        more = instruction.handler(*this, instruction);
+        executed++;
+    }
+    return executed;
+}
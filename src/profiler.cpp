@@ -0,0 +1,299 @@
+#include "../includes/chip.hpp"
+
+#ifdef CHIPPER_PROFILE
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+enum OpcodeClass {
+    op00E0, op00EE, op00CN, op00FB, op00FC, op00FD, op00FE, op00FF,
+    op1NNN, op2NNN, op3XNN, op4XNN, op5XY0, op6XNN, op7XNN, op8XY0,
+    op8XY1, op8XY2, op8XY3, op8XY4, op8XY5, op8XY6, op8XY7, op8XYE,
+    op9XY0, opANNN, opBNNN, opCXNN, opDXYN, opEX9E, opEXA1, opFX07,
+    opFX0A, opFX15, opFX18, opFX1E, opFX29, opFX30, opFX33, opFX55,
+    opFX65, opFX75, opFX85, opIllegal, opNativeBlock, classCount
+};
+
+static const char* classNames[classCount] = {
+    "00E0", "00EE", "00CN", "00FB", "00FC", "00FD", "00FE", "00FF",
+    "1NNN", "2NNN", "3XNN", "4XNN", "5XY0", "6XNN", "7XNN", "8XY0",
+    "8XY1", "8XY2", "8XY3", "8XY4", "8XY5", "8XY6", "8XY7", "8XYE",
+    "9XY0", "ANNN", "BNNN", "CXNN", "DXYN", "EX9E", "EXA1", "FX07",
+    "FX0A", "FX15", "FX18", "FX1E", "FX29", "FX30", "FX33", "FX55",
+    "FX65", "FX75", "FX85", "illegal", "jit block"};
+
+// decodes the same way as Chip::play()
+static OpcodeClass classify(Opcode opcode) {
+    switch (opcode & 0xF000) {
+    case 0x0000:
+        switch (opcode & 0x00FF) {
+        case 0x00E0:
+            return op00E0;
+        case 0x00EE:
+            return op00EE;
+        case 0x00FB:
+            return op00FB;
+        case 0x00FC:
+            return op00FC;
+        case 0x00FD:
+            return op00FD;
+        case 0x00FE:
+            return op00FE;
+        case 0x00FF:
+            return op00FF;
+        default:
+            if ((opcode & 0x00F0) == 0x00C0)
+                return op00CN;
+            return opIllegal;
+        }
+    case 0x1000:
+        return op1NNN;
+    case 0x2000:
+        return op2NNN;
+    case 0x3000:
+        return op3XNN;
+    case 0x4000:
+        return op4XNN;
+    case 0x5000:
+        return op5XY0;
+    case 0x6000:
+        return op6XNN;
+    case 0x7000:
+        return op7XNN;
+    case 0x8000:
+        switch (opcode & 0x000F) {
+        case 0x0000:
+            return op8XY0;
+        case 0x0001:
+            return op8XY1;
+        case 0x0002:
+            return op8XY2;
+        case 0x0003:
+            return op8XY3;
+        case 0x0004:
+            return op8XY4;
+        case 0x0005:
+            return op8XY5;
+        case 0x0006:
+            return op8XY6;
+        case 0x0007:
+            return op8XY7;
+        case 0x000E:
+            return op8XYE;
+        default:
+            return opIllegal;
+        }
+    case 0x9000:
+        return op9XY0;
+    case 0xA000:
+        return opANNN;
+    case 0xB000:
+        return opBNNN;
+    case 0xC000:
+        return opCXNN;
+    case 0xD000:
+        return opDXYN;
+    case 0xE000:
+        switch (opcode & 0x000F) {
+        case 0x000E:
+            return opEX9E;
+        case 0x0001:
+            return opEXA1;
+        default:
+            return opIllegal;
+        }
+    case 0xF000:
+        switch (opcode & 0x000F) {
+        case 0x0007:
+            return opFX07;
+        case 0x000A:
+            return opFX0A;
+        case 0x0005:
+            switch (opcode & 0x00F0) {
+            case 0x0010:
+                return opFX15;
+            case 0x0050:
+                return opFX55;
+            case 0x0060:
+                return opFX65;
+            case 0x0070:
+                return opFX75;
+            case 0x0080:
+                return opFX85;
+            default:
+                return opIllegal;
+            }
+        case 0x0000:
+            if ((opcode & 0x00F0) == 0x0030)
+                return opFX30;
+            return opIllegal;
+        case 0x0008:
+            return opFX18;
+        case 0x000E:
+            return opFX1E;
+        case 0x0009:
+            return opFX29;
+        case 0x0003:
+            return opFX33;
+        default:
+            return opIllegal;
+        }
+    default:
+        return opIllegal;
+    }
+}
+
+// only the thread that owns a profile writes to it, so plain loads and
+// stores are enough, they are atomic so a report from another thread can
+// read them at any time
+struct Counter {
+    std::atomic<uint64_t> executions{0};
+    std::atomic<uint64_t> cycles{0};
+
+    void add(uint64_t count, uint64_t elapsed) {
+        executions.store(executions.load(std::memory_order_relaxed) + count,
+                         std::memory_order_relaxed);
+        cycles.store(cycles.load(std::memory_order_relaxed) + elapsed,
+                     std::memory_order_relaxed);
+    }
+};
+
+struct Profile {
+    Counter classes[classCount];
+    Counter addresses[4096];
+};
+
+// one profile per thread that steps a machine, never freed so a report
+// still covers threads that have finished
+static std::mutex profilesLock;
+static std::vector<Profile*> profiles;
+static volatile std::sig_atomic_t reportRequested = 0;
+
+static void onSignal(int) { reportRequested = 1; }
+
+static Profile& threadProfile() {
+    thread_local Profile* profile = nullptr;
+    if (!profile) {
+        profile = new Profile();
+        std::lock_guard<std::mutex> lock(profilesLock);
+        if (profiles.empty()) {
+            std::atexit(Profiler::report);
+            std::signal(SIGUSR1, onSignal);
+        }
+        profiles.push_back(profile);
+    }
+    return *profile;
+}
+
+uint64_t Profiler::now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+}
+
+void Profiler::record(unsigned short pc, Opcode opcode, int instructions,
+                      uint64_t cycles) {
+    Profile& profile = threadProfile();
+    OpcodeClass type = instructions > 1 ? opNativeBlock : classify(opcode);
+    profile.classes[type].add(instructions, cycles);
+    profile.addresses[pc & 0x0FFF].add(instructions, cycles);
+
+    // printing is not safe inside a signal handler, so the handler only
+    // asks for a report and the next instruction prints it
+    if (reportRequested) {
+        reportRequested = 0;
+        report();
+    }
+}
+
+void Profiler::report() {
+    struct Line {
+        int id;
+        uint64_t executions;
+        uint64_t cycles;
+    };
+    std::vector<Line> classes(classCount);
+    std::vector<Line> addresses(4096);
+    for (int i = 0; i < classCount; i++)
+        classes[i] = {i, 0, 0};
+    for (int i = 0; i < 4096; i++)
+        addresses[i] = {i, 0, 0};
+
+    {
+        std::lock_guard<std::mutex> lock(profilesLock);
+        for (const Profile* profile : profiles) {
+            for (int i = 0; i < classCount; i++) {
+                classes[i].executions += profile->classes[i].executions;
+                classes[i].cycles += profile->classes[i].cycles;
+            }
+            for (int i = 0; i < 4096; i++) {
+                addresses[i].executions += profile->addresses[i].executions;
+                addresses[i].cycles += profile->addresses[i].cycles;
+            }
+        }
+    }
+
+    uint64_t totalExecutions = 0;
+    uint64_t totalCycles = 0;
+    for (const Line& line : classes) {
+        totalExecutions += line.executions;
+        totalCycles += line.cycles;
+    }
+    if (totalExecutions == 0)
+        return;
+
+    auto byCycles = [](const Line& a, const Line& b) {
+        return a.cycles > b.cycles;
+    };
+    std::sort(classes.begin(), classes.end(), byCycles);
+    std::sort(addresses.begin(), addresses.end(), byCycles);
+
+    std::fprintf(stderr, "\nprofile: %llu instructions, %llu cycles\n\n",
+                 (unsigned long long)totalExecutions,
+                 (unsigned long long)totalCycles);
+    std::fprintf(stderr, "%-10s %14s %16s %10s %7s\n", "opcode",
+                 "executions", "cycles", "per exec", "share");
+    for (const Line& line : classes) {
+        if (line.executions == 0)
+            continue;
+        std::fprintf(stderr, "%-10s %14llu %16llu %10.1f %6.1f%% ",
+                     classNames[line.id],
+                     (unsigned long long)line.executions,
+                     (unsigned long long)line.cycles,
+                     (double)line.cycles / line.executions,
+                     100.0 * line.cycles / totalCycles);
+        // a bar for the share of cycles, one character per 2% or part of it
+        uint64_t bar = (line.cycles * 50 + totalCycles - 1) / totalCycles;
+        for (uint64_t i = 0; i < bar; i++)
+            std::fputc('#', stderr);
+        std::fputc('\n', stderr);
+    }
+
+    // addresses are not told apart between ROMs, profile one ROM at a time
+    // to make sense of them
+    std::fprintf(stderr, "\n%-10s %14s %16s %10s %7s\n", "address",
+                 "executions", "cycles", "per exec", "share");
+    for (int i = 0; i < 16 && addresses[i].executions > 0; i++) {
+        const Line& line = addresses[i];
+        std::fprintf(stderr, "0x%03X      %14llu %16llu %10.1f %6.1f%%\n",
+                     line.id, (unsigned long long)line.executions,
+                     (unsigned long long)line.cycles,
+                     (double)line.cycles / line.executions,
+                     100.0 * line.cycles / totalCycles);
+    }
+}
+
+#endif
@@ -0,0 +1,79 @@
+#include <algorithm>
+
+#include "../includes/renderer.hpp"
+
+// texture size, one texel per pixel of the 128x64 display
+const int width = 128;
+const int height = 64;
+
+Renderer::Renderer(int pixelScale, sf::Color primaryColor,
+                   sf::Color secondaryColor)
+    : m_pixelScale(pixelScale), m_primaryColor(primaryColor),
+      m_secondaryColor(secondaryColor), m_shown(),
+      m_pixels(width * height * 4) {
+    m_texture.create(width, height);
+    m_sprite.setTexture(m_texture);
+    m_sprite.setScale(pixelScale, pixelScale);
+
+    // start out blank
+    for (int i = 0; i < width * height; i++) {
+        m_pixels[i * 4 + 0] = m_secondaryColor.r;
+        m_pixels[i * 4 + 1] = m_secondaryColor.g;
+        m_pixels[i * 4 + 2] = m_secondaryColor.b;
+        m_pixels[i * 4 + 3] = m_secondaryColor.a;
+    }
+    m_texture.update(&m_pixels[0]);
+}
+
+bool Renderer::rowChanged(const Frame& frame, int row) const {
+    if (frame.hires)
+        return frame.words[row * 2] != m_shown.words[row * 2] ||
+               frame.words[row * 2 + 1] != m_shown.words[row * 2 + 1];
+    return frame.words[row] != m_shown.words[row];
+}
+
+// writes one display row into the RGBA copy
+void Renderer::fillRow(const Frame& frame, int row) {
+    int scale = frame.hires ? 1 : 2;
+    sf::Uint8* pixels = &m_pixels[row * scale * width * 4];
+    for (int column = 0; column < width; column++) {
+        // in the 64x32 mode texel columns 2c and 2c+1 both show pixel c
+        int pixel = frame.hires ? row * 128 + column : row * 64 + column / 2;
+        bool set = (frame.words[pixel / 64] >> (63 - pixel % 64)) & 1;
+        const sf::Color& color = set ? m_primaryColor : m_secondaryColor;
+        pixels[column * 4 + 0] = color.r;
+        pixels[column * 4 + 1] = color.g;
+        pixels[column * 4 + 2] = color.b;
+        pixels[column * 4 + 3] = color.a;
+    }
+    if (scale == 2)
+        std::copy(pixels, pixels + width * 4, pixels + width * 4);
+}
+
+void Renderer::update(const Frame& frame) {
+    bool modeChanged = frame.hires != m_shown.hires;
+    int rows = frame.hires ? 64 : 32;
+    int scale = frame.hires ? 1 : 2;
+
+    // the changed rows are refilled and uploaded as one band, scrolling
+    // touches every row and a texture update per row adds up
+    int first = rows;
+    int last = -1;
+    for (int row = 0; row < rows; row++) {
+        if (!modeChanged && !rowChanged(frame, row))
+            continue;
+        fillRow(frame, row);
+        first = std::min(first, row);
+        last = row;
+    }
+    m_shown = frame;
+    if (last < 0)
+        return;
+
+    m_texture.update(&m_pixels[first * scale * width * 4], width,
+                     (last - first + 1) * scale, 0, first * scale);
+}
+
+void Renderer::draw(sf::RenderTarget& target) const {
+    target.draw(m_sprite);
+}
@@ -0,0 +1,137 @@
+#include <cstring>
+
+#include "../includes/rewind.hpp"
+
+Rewind::Rewind(int frames, int keyframeInterval)
+    : m_entries(frames), m_keyframeInterval(keyframeInterval), m_first(0),
+      m_count(0) {
+    std::memset(&m_keyframe, 0, sizeof(ChipState));
+    std::memset(&m_zero, 0, sizeof(ChipState));
+}
+
+void Rewind::clear() {
+    m_first = 0;
+    m_count = 0;
+}
+
+size_t Rewind::memoryUsed() const {
+    size_t bytes = 0;
+    for (int i = 0; i < m_count; i++)
+        bytes += m_entries[(m_first + i) % m_entries.size()].data.size();
+    return bytes;
+}
+
+// the encoding is a list of runs: a count of unchanged bytes, a count of
+// changed bytes and then the changed bytes xored with the base
+// counts are little endian base 128 so short runs take a single byte
+static void putCount(std::vector<Byte>& out, size_t count) {
+    while (count >= 0x80) {
+        out.push_back((Byte)(count | 0x80));
+        count >>= 7;
+    }
+    out.push_back((Byte)count);
+}
+
+static size_t getCount(const std::vector<Byte>& in, size_t& position) {
+    size_t count = 0;
+    int shift = 0;
+    while (in[position] & 0x80) {
+        count |= (size_t)(in[position++] & 0x7F) << shift;
+        shift += 7;
+    }
+    count |= (size_t)in[position++] << shift;
+    return count;
+}
+
+void Rewind::encode(const Byte* state, const Byte* base,
+                    std::vector<Byte>& out) {
+    out.clear();
+    size_t i = 0;
+    while (i < sizeof(ChipState)) {
+        size_t unchanged = i;
+        while (unchanged < sizeof(ChipState) &&
+               state[unchanged] == base[unchanged])
+            unchanged++;
+        size_t changed = unchanged;
+        while (changed < sizeof(ChipState) && state[changed] != base[changed])
+            changed++;
+        putCount(out, unchanged - i);
+        putCount(out, changed - unchanged);
+        for (size_t j = unchanged; j < changed; j++)
+            out.push_back(state[j] ^ base[j]);
+        i = changed;
+    }
+}
+
+void Rewind::decode(const std::vector<Byte>& in, const Byte* base,
+                    Byte* state) {
+    std::memcpy(state, base, sizeof(ChipState));
+    size_t position = 0;
+    size_t i = 0;
+    while (position < in.size()) {
+        i += getCount(in, position);
+        size_t changed = getCount(in, position);
+        for (size_t j = 0; j < changed; j++)
+            state[i++] ^= in[position++];
+    }
+}
+
+// keyframes are encoded against an all zero state
+void Rewind::decodeKeyframe(int slot, ChipState& state) const {
+    decode(m_entries[slot].data, (const Byte*)&m_zero, (Byte*)&state);
+}
+
+void Rewind::capture(const ChipState& state) {
+    int capacity = (int)m_entries.size();
+    if (m_count == capacity) {
+        // the oldest frame falls off, and any frames after it that depended
+        // on it as their keyframe go with it
+        m_first = (m_first + 1) % capacity;
+        m_count--;
+        while (m_count > 0 && m_entries[m_first].keyframeDistance != 0) {
+            m_first = (m_first + 1) % capacity;
+            m_count--;
+        }
+    }
+
+    int previous = (m_first + m_count - 1) % capacity;
+    int distance = m_count == 0
+                       ? 0
+                       : m_entries[previous].keyframeDistance + 1;
+    if (distance >= m_keyframeInterval)
+        distance = 0;
+
+    Entry& entry = m_entries[(m_first + m_count) % capacity];
+    entry.keyframeDistance = distance;
+    if (distance == 0) {
+        encode((const Byte*)&state, (const Byte*)&m_zero, entry.data);
+        std::memcpy(&m_keyframe, &state, sizeof(ChipState));
+    } else {
+        encode((const Byte*)&state, (const Byte*)&m_keyframe, entry.data);
+    }
+    m_count++;
+}
+
+bool Rewind::stepBack(ChipState& state) {
+    if (m_count == 0)
+        return false;
+
+    int capacity = (int)m_entries.size();
+    int newest = (m_first + m_count - 1) % capacity;
+    const Entry& entry = m_entries[newest];
+    if (entry.keyframeDistance == 0)
+        decodeKeyframe(newest, state);
+    else
+        decode(entry.data, (const Byte*)&m_keyframe, (Byte*)&state);
+    m_count--;
+
+    // stepping back past a keyframe means captures from here on are
+    // encoded against the one before it
+    if (entry.keyframeDistance == 0 && m_count > 0) {
+        int last = (m_first + m_count - 1) % capacity;
+        int keyframe =
+            (last - m_entries[last].keyframeDistance + capacity) % capacity;
+        decodeKeyframe(keyframe, m_keyframe);
+    }
+    return true;
+}
@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <filesystem>
+
+#include "../includes/romlibrary.hpp"
+
+#ifdef CHIPPER_EMBED_ROMS
+#include "../includes/rompack.hpp"
+#endif
+
+static uint64_t fnv1a(const std::vector<Byte>& data) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (Byte byte : data) {
+        hash ^= byte;
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+void RomLibrary::add(const std::string& name, std::vector<Byte> image) {
+    RomEntry entry;
+    entry.name = name;
+    entry.image = std::move(image);
+    entry.hash = fnv1a(entry.image);
+    entry.fits = entry.image.size() <= Chip::maxROMSize;
+    if (entry.fits)
+        entry.analysis = Analysis(entry.image.data(), entry.image.size());
+    entry.quirks = Chip::detectQuirks(entry.analysis);
+    m_entries.push_back(std::move(entry));
+}
+
+bool RomLibrary::scan(const std::string& directory) {
+    m_entries.clear();
+#ifdef CHIPPER_EMBED_ROMS
+    // the pack is already sorted
+    for (size_t i = 0; i < embeddedRomCount; i++) {
+        const EmbeddedRom& rom = embeddedRoms[i];
+        add(rom.name, std::vector<Byte>(rom.image, rom.image + rom.size));
+    }
+    if (!m_entries.empty())
+        return true;
+#endif
+    std::error_code error;
+    std::filesystem::directory_iterator files(directory, error);
+    if (error) {
+        std::cerr << "Failed to read ROM directory " << directory << "\n";
+        return false;
+    }
+
+    for (const auto& file : files) {
+        if (!file.is_regular_file())
+            continue;
+        std::string name = file.path().filename().string();
+        if (name == "README.md")
+            continue;
+
+        std::ifstream rom(file.path(),
+                          std::ios::in | std::ios::binary | std::ios::ate);
+        if (!rom.is_open())
+            continue;
+        std::vector<Byte> image((size_t)rom.tellg());
+        rom.seekg(0, std::ios::beg);
+        rom.read((char*)image.data(), image.size());
+        add(name, std::move(image));
+    }
+
+    std::sort(m_entries.begin(), m_entries.end(),
+              [](const RomEntry& a, const RomEntry& b) {
+                  return a.name < b.name;
+              });
+    return true;
+}
+
+int RomLibrary::find(const std::string& name) const {
+    for (size_t i = 0; i < m_entries.size(); i++)
+        if (m_entries[i].name == name)
+            return (int)i;
+    return -1;
+}
+
+int RomLibrary::next(int index, int direction) const {
+    int count = (int)m_entries.size();
+    for (int step = 1; step <= count; step++) {
+        int candidate = ((index + direction * step) % count + count) % count;
+        if (m_entries[candidate].fits)
+            return candidate;
+    }
+    return index;
+}
+
+void RomLibrary::setQuirks(Quirks quirks) {
+    for (RomEntry& entry : m_entries)
+        entry.quirks = quirks;
+}
+
+const Analysis* RomLibrary::load(Chip& chip, size_t index) const {
+    const RomEntry& entry = m_entries[index];
+    chip.setQuirks(entry.quirks);
+    if (!chip.loadROM(entry.image.data(), entry.image.size()))
+        return nullptr;
+    chip.pretranslate(entry.analysis);
+    return &entry.analysis;
+}
@@ -0,0 +1,94 @@
+#include "../includes/threadpool.hpp"
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+    : m_nextQueue(0), m_queued(0), m_pending(0), m_stopping(false) {
+    if (threadCount == 0)
+        threadCount = 1;
+
+    for (unsigned int i = 0; i < threadCount; i++)
+        m_queues.push_back(std::make_unique<Queue>());
+
+    for (unsigned int i = 0; i < threadCount; i++)
+        m_workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(m_stateLock);
+        m_stopping = true;
+    }
+    m_workAvailable.notify_all();
+    for (auto& worker : m_workers)
+        worker.join();
+}
+
+// tasks are spread round robin, stealing evens out whatever imbalance is left
+void ThreadPool::submit(Task task) {
+    unsigned int index = m_nextQueue++ % m_queues.size();
+    // counted before it is visible so a thief can never take it first
+    {
+        std::lock_guard<std::mutex> guard(m_stateLock);
+        m_queued++;
+        m_pending++;
+    }
+    {
+        std::lock_guard<std::mutex> guard(m_queues[index]->lock);
+        m_queues[index]->tasks.push_back(std::move(task));
+    }
+    m_workAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> guard(m_stateLock);
+    m_allDone.wait(guard, [this] { return m_pending == 0; });
+}
+
+// the owner works LIFO on its own deque, which keeps its cache warm
+bool ThreadPool::popLocal(unsigned int index, Task& task) {
+    Queue& queue = *m_queues[index];
+    std::lock_guard<std::mutex> guard(queue.lock);
+    if (queue.tasks.empty())
+        return false;
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+// thieves take the oldest task from the other end of a victim's deque
+bool ThreadPool::steal(unsigned int thief, Task& task) {
+    for (unsigned int i = 1; i < m_queues.size(); i++) {
+        Queue& victim = *m_queues[(thief + i) % m_queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(unsigned int index) {
+    while (true) {
+        Task task;
+        if (popLocal(index, task) || steal(index, task)) {
+            {
+                std::lock_guard<std::mutex> guard(m_stateLock);
+                m_queued--;
+            }
+            task();
+            std::lock_guard<std::mutex> guard(m_stateLock);
+            m_pending--;
+            if (m_pending == 0)
+                m_allDone.notify_all();
+            continue;
+        }
+
+        // nothing to run anywhere, sleep until a submit or shutdown
+        std::unique_lock<std::mutex> guard(m_stateLock);
+        m_workAvailable.wait(guard,
+                             [this] { return m_stopping || m_queued > 0; });
+        if (m_stopping && m_queued == 0)
+            return;
+    }
+}
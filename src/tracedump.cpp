@@ -0,0 +1,140 @@
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "../includes/tracer.hpp"
+
+// offline decoder for trace files
+// prints one line per recorded instruction, filtered by address range,
+// opcode pattern, cycle range or changed register
+
+struct Filter {
+    unsigned int firstPC = 0x000;
+    unsigned int lastPC = 0xFFF;
+    // opcodes match when (opcode & mask) == value
+    uint16_t opcodeMask = 0x0000;
+    uint16_t opcodeValue = 0x0000;
+    uint64_t firstCycle = 0;
+    uint64_t lastCycle = UINT64_MAX;
+    int reg = -1;
+    uint64_t limit = UINT64_MAX;
+
+    bool matches(const TraceRecord& record) const {
+        return record.pc >= firstPC && record.pc <= lastPC &&
+               (record.opcode & opcodeMask) == opcodeValue &&
+               record.cycle >= firstCycle && record.cycle <= lastCycle &&
+               (reg < 0 || record.reg == reg);
+    }
+};
+
+// a pattern like D01N or 8XY4, hex digits have to match and anything else
+// matches any digit
+static bool parsePattern(const std::string& pattern, Filter& filter) {
+    if (pattern.size() != 4)
+        return false;
+    filter.opcodeMask = 0;
+    filter.opcodeValue = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = pattern[i];
+        int shift = (3 - i) * 4;
+        if (std::isxdigit((unsigned char)c)) {
+            int digit = std::stoi(std::string(1, c), nullptr, 16);
+            filter.opcodeMask |= 0xF << shift;
+            filter.opcodeValue |= digit << shift;
+        }
+    }
+    return true;
+}
+
+// first-last in hex, or a single address
+static void parseRange(const std::string& range, unsigned int& first,
+                       unsigned int& last) {
+    size_t dash = range.find('-');
+    first = std::stoul(range.substr(0, dash), nullptr, 16);
+    last = dash == std::string::npos
+               ? first
+               : std::stoul(range.substr(dash + 1), nullptr, 16);
+}
+
+int main(int argc, char* argv[]) {
+    std::string path;
+    Filter filter;
+    bool valid = argc > 1;
+    for (int i = 1; i < argc && valid; i++) {
+        std::string arg(argv[i]);
+        if (arg.rfind("pc=", 0) == 0) {
+            parseRange(arg.substr(3), filter.firstPC, filter.lastPC);
+        } else if (arg.rfind("opcode=", 0) == 0) {
+            valid = parsePattern(arg.substr(7), filter);
+        } else if (arg.rfind("from=", 0) == 0) {
+            filter.firstCycle = std::stoull(arg.substr(5));
+        } else if (arg.rfind("to=", 0) == 0) {
+            filter.lastCycle = std::stoull(arg.substr(3));
+        } else if (arg.rfind("reg=", 0) == 0) {
+            filter.reg = std::stoi(arg.substr(4), nullptr, 16) & 0xF;
+        } else if (arg.rfind("limit=", 0) == 0) {
+            filter.limit = std::stoull(arg.substr(6));
+        } else if (path.empty()) {
+            path = arg;
+        } else {
+            valid = false;
+        }
+    }
+    if (!valid || path.empty()) {
+        std::cerr << "Usage: ./tracedump [trace file] [?pc=first-last] "
+                     "[?opcode=pattern] [?from=cycle] [?to=cycle] "
+                     "[?reg=V] [?limit=count]\n";
+        exit(TRACE_LOAD_ERR);
+    }
+
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    TraceHeader header;
+    if (!file || std::fread(&header, sizeof(header), 1, file) != 1 ||
+        std::memcmp(header.magic, "C8TR", 4) != 0 ||
+        header.version != TRACE_VERSION ||
+        header.recordSize != sizeof(TraceRecord)) {
+        std::cerr << "Not a trace file, or from another version\n";
+        exit(TRACE_LOAD_ERR);
+    }
+
+    uint64_t records = 0;
+    uint64_t shown = 0;
+    uint64_t dropped = 0;
+    uint64_t nextCycle = 0;
+    TraceRecord block[4096];
+    size_t count;
+    while (shown < filter.limit &&
+           (count = std::fread(block, sizeof(TraceRecord), 4096, file)) > 0) {
+        for (size_t i = 0; i < count && shown < filter.limit; i++) {
+            const TraceRecord& record = block[i];
+            records++;
+            // cycles count on while the ring is full, a gap is lost records
+            if (record.cycle != nextCycle) {
+                dropped += record.cycle - nextCycle;
+                if (nextCycle <= filter.lastCycle &&
+                    record.cycle > filter.firstCycle)
+                    std::printf("%10llu  -- %llu records dropped\n",
+                                (unsigned long long)nextCycle,
+                                (unsigned long long)(record.cycle -
+                                                     nextCycle));
+            }
+            nextCycle = record.cycle + 1;
+            if (!filter.matches(record))
+                continue;
+
+            shown++;
+            std::printf("%10llu  %03X  %04X  I=%03X",
+                        (unsigned long long)record.cycle, record.pc,
+                        record.opcode, record.index);
+            if (record.reg != Tracer::noRegister)
+                std::printf("  V%X=%02X", record.reg, record.value);
+            std::printf("\n");
+        }
+    }
+    std::fclose(file);
+
+    std::cerr << records << " records read, " << shown << " shown, "
+              << dropped << " dropped\n";
+    return 0;
+}
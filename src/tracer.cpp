@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "../includes/tracer.hpp"
+
+Tracer::Tracer(size_t capacity)
+    : m_cycle(0), m_head(0), m_tail(0), m_dropped(0), m_running(false),
+      m_file(nullptr) {
+    size_t size = 1;
+    while (size < capacity)
+        size *= 2;
+    m_ring.resize(size);
+}
+
+Tracer::~Tracer() { stop(); }
+
+bool Tracer::start(const std::string& path) {
+    stop();
+    m_file = std::fopen(path.c_str(), "wb");
+    if (!m_file)
+        return false;
+
+    TraceHeader header;
+    std::memcpy(header.magic, "C8TR", 4);
+    header.version = TRACE_VERSION;
+    header.recordSize = sizeof(TraceRecord);
+    std::fwrite(&header, sizeof(header), 1, m_file);
+
+    m_cycle = 0;
+    m_head.store(0);
+    m_tail.store(0);
+    m_dropped.store(0);
+    m_running.store(true);
+    m_writer = std::thread(&Tracer::drain, this);
+    return true;
+}
+
+void Tracer::stop() {
+    if (!m_file)
+        return;
+    m_running.store(false);
+    m_writer.join();
+    std::fclose(m_file);
+    m_file = nullptr;
+}
+
+void Tracer::drain() {
+    size_t size = m_ring.size();
+    while (true) {
+        // read before looking at the ring, so nothing recorded before
+        // stop() is left behind
+        bool running = m_running.load();
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t head = m_head.load(std::memory_order_acquire);
+        if (head == tail) {
+            if (!running)
+                break;
+            // a frame's worth of records is a few hundred, there is no hurry
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            continue;
+        }
+
+        // up to the end of the ring, the rest goes on the next pass
+        size_t start = tail & (size - 1);
+        size_t count = std::min(head - tail, size - start);
+        std::fwrite(&m_ring[start], sizeof(TraceRecord), count, m_file);
+        m_tail.store(tail + count, std::memory_order_release);
+    }
+    std::fflush(m_file);
+}